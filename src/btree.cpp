@@ -5,8 +5,10 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
 #include "btree.h"
 #include "filescan.h"
+#include "node_search.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
@@ -25,6 +27,112 @@
 namespace badgerdb
 {
 
+/**
+ * Read a key of type T from a record or from a key passed in by the caller.
+ * STRING keys are cut at the first NUL byte or after STRINGSIZE bytes.
+ */
+template <class T>
+static T readKey(const void *data) {
+    return *(const T *)data;
+}
+
+template <>
+std::string readKey<std::string>(const void *data) {
+    const char *chars = (const char *)data;
+    return std::string(chars, strnlen(chars, STRINGSIZE));
+}
+
+/*
+Accessors shared by the node layouts, so that searches and scans can be written
+once for every key type. The STRING versions of the searches live in string_node.h.
+*/
+
+template <class T>
+static inline int lowerBound(const LeafNode<T> *node, const T key) {
+    return lowerBound(node->keyArray, node->numKeys, key);
+}
+
+template <class T>
+static inline int upperBound(const LeafNode<T> *node, const T key) {
+    return upperBound(node->keyArray, node->numKeys, key);
+}
+
+template <class T>
+static inline int lowerBound(const NonLeafNode<T> *node, const T key) {
+    return lowerBound(node->keyArray, node->numKeys, key);
+}
+
+template <class T>
+static inline int upperBound(const NonLeafNode<T> *node, const T key) {
+    return upperBound(node->keyArray, node->numKeys, key);
+}
+
+template <class T>
+static inline PageId childPageNo(const NonLeafNode<T> *node, const int i) {
+    return node->pageNoArray[i];
+}
+
+template <class T>
+static inline int compareKey(const LeafNode<T> *node, const int i, const T key) {
+    return node->keyArray[i] < key ? -1 : (key < node->keyArray[i] ? 1 : 0);
+}
+
+static inline int compareKey(const StringLeafNode *node, const int i, const std::string &key) {
+    return compareStringKey(node, i, key);
+}
+
+/**
+ * Copy out the record ids of count entries of a leaf, starting at entry begin.
+ */
+template <class T>
+static inline void copyRids(const LeafNode<T> *node, const int begin, const size_t count, RecordId *out) {
+    memcpy(out, &node->ridArray[begin], count * sizeof(RecordId));
+}
+
+static inline void copyRids(const StringLeafNode *node, const int begin, const size_t count, RecordId *out) {
+    for (size_t i = 0; i < count; ++i)
+        out[i] = node->slotArray[begin + i].rid;
+}
+
+template <class T>
+static inline RecordId ridAt(const LeafNode<T> *node, const int i) {
+    return node->ridArray[i];
+}
+
+static inline RecordId ridAt(const StringLeafNode *node, const int i) {
+    return node->slotArray[i].rid;
+}
+
+/**
+ * Find the entry <key,rid> in a leaf.
+ * @return Index of the entry; if it is not there, the index of the first key
+ * greater than key, or numKeys when the leaf ends in duplicates of key, so that
+ * the entry may still be in the next leaf
+ */
+template <class Leaf, class K>
+static inline int findEntry(const Leaf *node, const K &key, const RecordId rid) {
+    int i = lowerBound(node, key);
+    while (i < node->numKeys && compareKey(node, i, key) == 0 && ridAt(node, i) != rid)
+        i++;
+    return i;
+}
+
+// STRING nodes are slotted pages, so building and changing them has its own code further down
+template <>
+const void BTreeIndex::bulkLoadLeaves<std::string>(const std::vector<RIDKeyPair<std::string> > &entries,
+                                                   std::vector<PageKeyPair<std::string> > &parentEntries);
+
+template <>
+const void BTreeIndex::bulkLoadNonLeaves<std::string>(const std::vector<PageKeyPair<std::string> > &childEntries,
+                                                      const int level,
+                                                      std::vector<PageKeyPair<std::string> > &parentEntries);
+
+template <>
+const void BTreeIndex::insertKey<std::string>(const std::string key, const RecordId rid);
+
+template <>
+const bool BTreeIndex::deleteKey<std::string>(const std::string key, const RecordId rid);
+
 // -----------------------------------------------------------------------------
 // BTreeIndex::BTreeIndex -- Constructor
 // -----------------------------------------------------------------------------
@@ -33,7 +141,9 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		std::string & outIndexName,
 		BufMgr *bufMgrIn,
 		const int attrByteOffset,
-		const Datatype attrType)
+		const Datatype attrType,
+		const double fillFactor)
+    : scanCursor(this)
 {
     std::ostringstream idxStr;
     idxStr << relationName << "." << attrByteOffset;
@@ -42,12 +152,18 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
     this->bufMgr = bufMgrIn;
     this->attrByteOffset = attrByteOffset;
     attributeType = attrType;
-    leafOccupancy = INTARRAYLEAFSIZE;
-    nodeOccupancy = INTARRAYNONLEAFSIZE;
-    scanExecuting = false;
-    nextEntry = leafOccupancy;  // set for simplicity in scanNext
-    currentPageNum = 0;
-    currentPageData = nullptr;
+    if (attrType == DOUBLE) {
+        leafOccupancy = DOUBLEARRAYLEAFSIZE;
+        nodeOccupancy = DOUBLEARRAYNONLEAFSIZE;
+    } else if (attrType == STRING) {
+        leafOccupancy = sizeof(StringLeafNode::slotArray) / sizeof(StringLeafSlot);
+        nodeOccupancy = sizeof(StringNonLeafNode::slotArray) / sizeof(StringNonLeafSlot);
+    } else {
+        leafOccupancy = INTARRAYLEAFSIZE;
+        nodeOccupancy = INTARRAYNONLEAFSIZE;
+    }
+    this->fillFactor = (fillFactor > 0 && fillFactor <= 1) ? fillFactor : BULKLOAD_FILL_FACTOR;
+    this->rangeScans = 0;
 
     // create blobfile, fill in metainfo, etc
     bool fileExist = true;
@@ -62,55 +178,42 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 
     if (fileExist) {
         headerPageNum = file->getFirstPageNo();
-        Page* headerPage;
-        bufMgr->readPage(file, headerPageNum, headerPage);
-        metaInfo = (IndexMetaInfo*)headerPage;
+        PageHandle headerPage = bufMgr->readPage(file, headerPageNum);
+        metaInfo = (IndexMetaInfo*)headerPage.get();
         if (metaInfo->attrByteOffset != attrByteOffset ||
         metaInfo->attrType != attrType ||
         strcmp(metaInfo->relationName, relationName.c_str()) != 0) {
             throw BadIndexInfoException("metaInfo does not match");
         }
         rootPageNum = metaInfo->rootPageNo;
-        bufMgr->unPinPage(file, headerPageNum, false);
+        bool needUpgrade = metaInfo->version < INDEX_FORMAT_VERSION;
+        headerPage.release();
+        if (needUpgrade) {
+            upgradeIndexFile();
+        }
     } else {
         // init headerPage
-        Page* headerPage;
-        bufMgr->allocPage(file, headerPageNum, headerPage);
-        memset(headerPage, 0, headerPage->SIZE);
-        metaInfo = (IndexMetaInfo*)headerPage;
+        PageHandle headerPage = bufMgr->allocPage(file, headerPageNum);
+        memset(headerPage.get(), 0, Page::SIZE);
+        metaInfo = (IndexMetaInfo*)headerPage.get();
         strncpy(metaInfo->relationName, relationName.c_str(), sizeof(metaInfo->relationName));
         metaInfo->attrType = attrType;
         metaInfo->attrByteOffset = attrByteOffset;
-        // init rootPage
-        Page* rootPage;
-        bufMgr->allocPage(file, rootPageNum, rootPage);
-        memset(rootPage, 0, rootPage->SIZE);
-        metaInfo->rootPageNo = rootPageNum;
-        ((LeafNodeInt *)rootPage)->rightSibPageNo = 0;
-        // unpin
-        bufMgr->unPinPage(file, headerPageNum, true);
-        bufMgr->unPinPage(file, rootPageNum, true);
-
-        //fill the newly created Blob File using filescan
-        FileScan fileScan(relationName, bufMgr);
-        RecordId rid;
-        try
-        {
-            int i = 1;
-            while(1)
-            {
-                fileScan.scanNext(rid);
-                std::string record = fileScan.getRecord();
-                insertEntry(record.c_str() + attrByteOffset, rid);
-                ++i;
-            }
-        }
-        catch(EndOfFileException e)
-        {
-            // save Btee index file to disk
-            bufMgr->flushFile(file);
+        metaInfo->version = INDEX_FORMAT_VERSION;
+        headerPage.release();
+
+        // build the tree bottom-up and save Btee index file to disk
+        if (attrType == DOUBLE) {
+            bulkLoadRelation<double>(relationName);
+        } else if (attrType == STRING) {
+            bulkLoadRelation<std::string>(relationName);
+        } else {
+            bulkLoadRelation<int>(relationName);
         }
+        bufMgr->flushFile(file);
     }
+    // lookups probe single pages until a range scan says otherwise
+    file->advise(RANDOM_ACCESS);
 }
 
 
@@ -120,21 +223,21 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 // TODO: think about others need to be destructed
 BTreeIndex::~BTreeIndex()
 {
-    scanExecuting = false;
-    bufMgr->flushFile(file);
-    if (currentPageNum != 0) {
-        try {
-            bufMgr->unPinPage(file, currentPageNum, true);
-        } catch (PageNotPinnedException e) {
-
-        } catch (HashNotFoundException e) {
-
-        }
+    if (scanCursor.scanExecuting) {
+        scanCursor.endScan();
     }
+    bufMgr->flushFile(file);
     delete file;
     file = nullptr;
 }
 
+const void BTreeIndex::adviseRangeScan(const bool starting) {
+    std::lock_guard<std::mutex> guard(accessHintMutex);
+    if (starting ? rangeScans++ == 0 : --rangeScans == 0) {
+        file->advise(rangeScans > 0 ? SEQUENTIAL_ACCESS : RANDOM_ACCESS);
+    }
+}
+
 /**
  * Change the rootPageNum to the newRootPageNum, and change the info in
  * metaPage as well.
@@ -142,11 +245,273 @@ BTreeIndex::~BTreeIndex()
  */
 const void BTreeIndex::changeRootPageNum(const PageId newRootPageNum) {
     rootPageNum = newRootPageNum;
-    Page* headerPage;
-    bufMgr->readPage(file, headerPageNum, headerPage);
-    IndexMetaInfo* metaInfo = (IndexMetaInfo*)headerPage;
+    PageHandle headerPage = bufMgr->readPage(file, headerPageNum);
+    IndexMetaInfo* metaInfo = (IndexMetaInfo*)headerPage.get();
     metaInfo->rootPageNo = rootPageNum;
-    bufMgr->unPinPage(file, headerPageNum, true);
+    headerPage.markDirty();
+}
+
+/**
+ * Collect every <key, rid> pair of the relation using filescan, then bulk load
+ * the tree from them.
+ * @param relationName Name of the base relation
+ */
+template <class T>
+const void BTreeIndex::bulkLoadRelation(const std::string &relationName) {
+    std::vector<RIDKeyPair<T> > entries;
+    {
+        // the relation is read once, so keep it from flushing the pool
+        FileScan fileScan(relationName, bufMgr, true);
+        RecordId rid;
+        try
+        {
+            while(1)
+            {
+                fileScan.scanNext(rid);
+                std::string record = fileScan.getRecord();
+                RIDKeyPair<T> entryPair;
+                entryPair.set(rid, readKey<T>(record.c_str() + attrByteOffset));
+                entries.push_back(entryPair);
+            }
+        }
+        catch(EndOfFileException e)
+        {
+        }
+    }
+    bulkLoad(entries);
+}
+
+/**
+ * Build the whole tree bottom-up from entries. Leaves are packed left to right,
+ * then every non-leaf level is built on top of the level below until a single
+ * root is left. The first leaf always gets page 2, so a tree made of one leaf
+ * keeps its root there.
+ * @param entries All the record-key pairs of the relation, sorted in place
+ */
+template <class T>
+const void BTreeIndex::bulkLoad(std::vector<RIDKeyPair<T> > &entries) {
+    std::sort(entries.begin(), entries.end());
+    std::vector<PageKeyPair<T> > levelEntries;
+    bulkLoadLeaves(entries, levelEntries);
+    int level = 1;
+    while (levelEntries.size() > 1) {
+        std::vector<PageKeyPair<T> > parentEntries;
+        bulkLoadNonLeaves(levelEntries, level, parentEntries);
+        levelEntries.swap(parentEntries);
+        level = 0;
+    }
+    changeRootPageNum(levelEntries[0].pageNo);
+}
+
+/**
+ * Pack sorted entries into leaves filled up to fillFactor, spreading them evenly
+ * so the last leaf is not left almost empty. Each leaf stays pinned until the
+ * next one is allocated so its sibling pointer can be set before it is unpinned.
+ * @param entries Sorted record-key pairs
+ * @param parentEntries Returns the pageNo and smallest key of every leaf, in order
+ */
+template <class T>
+const void BTreeIndex::bulkLoadLeaves(const std::vector<RIDKeyPair<T> > &entries,
+                                      std::vector<PageKeyPair<T> > &parentEntries) {
+    const int total = entries.size();
+    const int perLeaf = std::max(1, (int)(leafOccupancy * fillFactor));
+    const int numLeaves = std::max(1, (total + perLeaf - 1) / perLeaf);
+    LeafNode<T> *prevLeafNode = nullptr;
+    int next = 0;
+    for (int leaf = 0; leaf < numLeaves; ++leaf) {
+        PageId pageId;
+        Page *page;
+        bufMgr->allocPage(file, pageId, page);
+        memset(page, 0, page->SIZE);
+        LeafNode<T> *leafNode = (LeafNode<T> *)page;
+        int count = total / numLeaves + (leaf < total % numLeaves ? 1 : 0);
+        for (int i = 0; i < count; ++i, ++next) {
+            leafNode->keyArray[i] = entries[next].key;
+            leafNode->ridArray[i] = entries[next].rid;
+        }
+        leafNode->numKeys = count;
+        PageKeyPair<T> parentEntry;
+        parentEntry.set(pageId, count > 0 ? leafNode->keyArray[0] : 0);
+        parentEntries.push_back(parentEntry);
+        if (prevLeafNode != nullptr) {
+            prevLeafNode->rightSibPageNo = pageId;
+            bufMgr->unPinPage((Page *)prevLeafNode, true);
+        }
+        prevLeafNode = leafNode;
+    }
+    bufMgr->unPinPage((Page *)prevLeafNode, true);
+}
+
+/**
+ * Build one non-leaf level on top of childEntries. Every child but the first of
+ * a node contributes its smallest key as the separator in front of it. The last
+ * node is never left with a single child.
+ * @param childEntries PageNo and smallest key of every node on the level below, in order
+ * @param level Level to store in the new nodes, 1 if the children are leaves
+ * @param parentEntries Returns the pageNo and smallest key of every new node, in order
+ */
+template <class T>
+const void BTreeIndex::bulkLoadNonLeaves(const std::vector<PageKeyPair<T> > &childEntries, const int level,
+                                         std::vector<PageKeyPair<T> > &parentEntries) {
+    const int total = childEntries.size();
+    const int perNode = std::max(2, (int)(nodeOccupancy * fillFactor) + 1);
+    const int numNodes = (total + perNode - 1) / perNode;
+    int next = 0;
+    for (int node = 0; next < total; ++node) {
+        PageId pageId;
+        Page *page;
+        bufMgr->allocPage(file, pageId, page);
+        memset(page, 0, page->SIZE);
+        NonLeafNode<T> *nonLeafNode = (NonLeafNode<T> *)page;
+        nonLeafNode->level = level;
+        int count = total / numNodes + (node < total % numNodes ? 1 : 0);
+        // a node with one child has no key, so this node takes the last child
+        if (total - next - count == 1)
+            ++count;
+        PageKeyPair<T> parentEntry;
+        parentEntry.set(pageId, childEntries[next].key);
+        parentEntries.push_back(parentEntry);
+        nonLeafNode->pageNoArray[0] = childEntries[next++].pageNo;
+        for (int i = 1; i < count; ++i, ++next) {
+            nonLeafNode->keyArray[i-1] = childEntries[next].key;
+            nonLeafNode->pageNoArray[i] = childEntries[next].pageNo;
+        }
+        nonLeafNode->numKeys = count - 1;
+        bufMgr->unPinPage(page, true);
+    }
+}
+
+/**
+ * Pack sorted entries into STRING leaves, each filled up to fillFactor of its bytes.
+ * The key in front of every leaf but the first is cut down to the shortest
+ * separator that still tells it apart from the last key of the leaf before.
+ * @param entries Sorted record-key pairs
+ * @param parentEntries Returns the pageNo and separator key of every leaf, in order
+ */
+template <>
+const void BTreeIndex::bulkLoadLeaves<std::string>(const std::vector<RIDKeyPair<std::string> > &entries,
+                                                   std::vector<PageKeyPair<std::string> > &parentEntries) {
+    std::vector<std::string> keys;
+    std::vector<RecordId> rids;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        keys.push_back(entries[i].key);
+        rids.push_back(entries[i].rid);
+    }
+    const int total = keys.size();
+    const int budget = (int)(Page::SIZE * fillFactor);
+    StringLeafNode *prevLeafNode = nullptr;
+    int next = 0;
+    do {
+        PageId pageId;
+        Page *page;
+        bufMgr->allocPage(file, pageId, page);
+        memset(page, 0, page->SIZE);
+        StringLeafNode *leafNode = (StringLeafNode *)page;
+        int count = next < total ? stringLeafFill(keys, next, budget) : 0;
+        encodeStringLeaf(leafNode, keys, rids, next, next + count);
+        PageKeyPair<std::string> parentEntry;
+        parentEntry.set(pageId, next > 0 ? truncatedSeparator(keys[next - 1], keys[next]) : "");
+        parentEntries.push_back(parentEntry);
+        if (prevLeafNode != nullptr) {
+            prevLeafNode->rightSibPageNo = pageId;
+            bufMgr->unPinPage((Page *)prevLeafNode, true);
+        }
+        prevLeafNode = leafNode;
+        next += count;
+    } while (next < total);
+    bufMgr->unPinPage((Page *)prevLeafNode, true);
+}
+
+/**
+ * Build one STRING non-leaf level on top of childEntries, filling each node up to
+ * fillFactor of its bytes. The last node is never left with a single child.
+ * @param childEntries PageNo and separator key of every node on the level below, in order
+ * @param level Level to store in the new nodes, 1 if the children are leaves
+ * @param parentEntries Returns the pageNo and separator key of every new node, in order
+ */
+template <>
+const void BTreeIndex::bulkLoadNonLeaves<std::string>(const std::vector<PageKeyPair<std::string> > &childEntries,
+                                                      const int level,
+                                                      std::vector<PageKeyPair<std::string> > &parentEntries) {
+    const int total = childEntries.size();
+    // separators[i] goes between child i and child i + 1
+    std::vector<std::string> separators;
+    std::vector<PageId> pageNos;
+    for (int i = 0; i < total; ++i) {
+        if (i > 0)
+            separators.push_back(childEntries[i].key);
+        pageNos.push_back(childEntries[i].pageNo);
+    }
+    const int budget = (int)(Page::SIZE * fillFactor);
+    int next = 0;
+    while (next < total) {
+        PageId pageId;
+        Page *page;
+        bufMgr->allocPage(file, pageId, page);
+        memset(page, 0, page->SIZE);
+        StringNonLeafNode *nonLeafNode = (StringNonLeafNode *)page;
+        nonLeafNode->level = level;
+        int count = stringNonLeafFill(separators, next, budget) + 1;
+        if (total - next - count == 1)
+            count += count == 2 ? 1 : -1;
+        encodeStringNonLeaf(nonLeafNode, separators, pageNos, next, next + count - 1);
+        PageKeyPair<std::string> parentEntry;
+        parentEntry.set(pageId, childEntries[next].key);
+        parentEntries.push_back(parentEntry);
+        next += count;
+        bufMgr->unPinPage(page, true);
+    }
+}
+
+/**
+ * Version 1 layout of a non-leaf node. It only differs from NonLeafNodeInt in
+ * the level field, which filled the bytes where numKeys is now kept.
+ */
+struct NonLeafNodeIntV1 {
+    int level;
+    int keyArray[INTARRAYNONLEAFSIZE];
+    PageId pageNoArray[INTARRAYNONLEAFSIZE + 1];
+};
+
+/**
+ * Rewrite every node of a version 1 index file in the current layout, then
+ * stamp the new version in the meta page.
+ */
+const void BTreeIndex::upgradeIndexFile() {
+    upgradeNode(rootPageNum, rootPageNum == 2);
+    PageHandle headerPage = bufMgr->readPage(file, headerPageNum);
+    ((IndexMetaInfo*)headerPage.get())->version = INDEX_FORMAT_VERSION;
+    headerPage.markDirty();
+}
+
+/**
+ * Store the key count of a version 1 node, and of all the nodes below it.
+ * Version 1 nodes kept their entries packed at the front, with empty slots
+ * holding a zero page number, so the count is the first empty slot.
+ * @param pageNo PageId of the node
+ * @param isLeaf The node is a leaf or not
+ */
+const void BTreeIndex::upgradeNode(const PageId pageNo, const bool isLeaf) {
+    PageHandle page = bufMgr->readPage(file, pageNo);
+    page.markDirty();
+    if (isLeaf) {
+        LeafNodeInt* leafNode = (LeafNodeInt*)page.get();
+        int count = 0;
+        while (count < leafOccupancy && leafNode->ridArray[count].page_number != 0)
+            ++count;
+        leafNode->numKeys = count;
+    } else {
+        NonLeafNodeIntV1* oldNode = (NonLeafNodeIntV1*)page.get();
+        int level = oldNode->level;
+        int count = 0;
+        while (count < nodeOccupancy && oldNode->pageNoArray[count+1] != 0)
+            ++count;
+        NonLeafNodeInt* nonLeafNode = (NonLeafNodeInt*)page.get();
+        nonLeafNode->level = level;
+        nonLeafNode->numKeys = count;
+        for (int i = 0; i <= count; ++i)
+            upgradeNode(nonLeafNode->pageNoArray[i], level == 1);
+    }
 }
 
 // -----------------------------------------------------------------------------
@@ -155,166 +520,530 @@ const void BTreeIndex::changeRootPageNum(const PageId newRootPageNum) {
 
 const void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
 {
-    PageKeyPair<int> newEntry {0, 0};
-    RIDKeyPair<int> entryPair;
-    entryPair.set(rid, *(int *)key);
-    insertEntryHelper(rootPageNum == 2, rootPageNum, newEntry, entryPair);
+    if (attributeType == DOUBLE) {
+        insertKey(*(double *)key, rid);
+    } else if (attributeType == STRING) {
+        insertKey(readKey<std::string>(key), rid);
+    } else {
+        insertKey(*(int *)key, rid);
+    }
 }
 
 /**
- * place the entryPair in the recurrent Leaf node
- * @requires node has space
- * @param entryPair the record-key pair to be placed
- * @param node the leaf node
+ * Insert the pair <key,rid> into a tree whose keys are of type T.
+ * @param key Key to insert
+ * @param rid Record ID of the record whose entry is getting inserted
  */
-const void BTreeIndex::placeEntry(RIDKeyPair<int> entryPair, LeafNodeInt *node) {
-    int i = 0;
-    while (node->ridArray[i].page_number != 0 && node->keyArray[i] < entryPair.key) {
-        i++;
-    }
-    if (node->ridArray[i].page_number == 0) {  // i is empty, place node here
-        node->ridArray[i] = entryPair.rid;
-        node->keyArray[i] = entryPair.key;
-    } else {    // i is the first key that greater than entryPair.key
-        int j = leafOccupancy - 1;
-        // move all the elements after i rightforward 1
-        while (j >= i) {
-            if (node->ridArray[j].page_number != 0) {
-                node->ridArray[j+1] = node->ridArray[j];
-                node->keyArray[j+1] = node->keyArray[j];
+template <class T>
+const void BTreeIndex::insertKey(const T key, const RecordId rid)
+{
+    RIDKeyPair<T> entryPair;
+    entryPair.set(rid, key);
+    // latch down to the leaf, keeping only the nodes a split could reach
+    std::vector<LatchedNode> path;
+    // index of each node on the path in the pageNoArray of the node above it
+    std::vector<int> childIndexes;
+    rootLatch.lockExclusive();
+    bool rootLatched = true;
+    PageId pageNo = rootPageNum;
+    bool isLeaf = rootPageNum == 2;
+    int childIndex = 0;
+    while (1) {
+        LatchedNode node;
+        node.pageNo = pageNo;
+        bufMgr->readPage(file, pageNo, node.page);
+        bufMgr->latchPage(node.page, true);
+        bool safe = isLeaf ? ((LeafNode<T> *)node.page)->numKeys < leafOccupancy
+                           : ((NonLeafNode<T> *)node.page)->numKeys < nodeOccupancy;
+        if (safe) {
+            releaseNodes(path, false);
+            childIndexes.clear();
+            if (rootLatched) {
+                rootLatch.unlock();
+                rootLatched = false;
             }
-            j--;
         }
-        node->ridArray[i] = entryPair.rid;
-        node->keyArray[i] = entryPair.key;
+        path.push_back(node);
+        childIndexes.push_back(childIndex);
+        if (isLeaf)
+            break;
+        NonLeafNode<T> *nonLeafNode = (NonLeafNode<T> *)node.page;
+        // first key greater than entryPair.key bounds the subtree to descend into
+        childIndex = upperBound(nonLeafNode->keyArray, nonLeafNode->numKeys, entryPair.key);
+        pageNo = nonLeafNode->pageNoArray[childIndex];
+        isLeaf = nonLeafNode->level == 1;
+    }
+
+    // insert or split the leaf, then push splits up the latched path
+    PageKeyPair<T> newChildEntry;
+    newChildEntry.set(0, 0);
+    LeafNode<T> *leafNode = (LeafNode<T> *)path.back().page;
+    if (leafNode->numKeys < leafOccupancy) {
+        placeEntry(entryPair, leafNode);
+    } else {
+        splitLeaf(leafNode, newChildEntry, entryPair, path.back().pageNo);
+    }
+    for (int i = (int)path.size() - 2; i >= 0 && newChildEntry.pageNo != 0; --i) {
+        NonLeafNode<T> *nonLeafNode = (NonLeafNode<T> *)path[i].page;
+        if (nonLeafNode->numKeys < nodeOccupancy) {
+            placeNewChild(newChildEntry, nonLeafNode, childIndexes[i + 1]);
+            newChildEntry.set(0, 0);
+        } else {
+            // newChildEntry point to smallest key on second half
+            splitNonLeaf(nonLeafNode, path[i].pageNo, newChildEntry, childIndexes[i + 1]);
+        }
+    }
+    // every node left on the path was changed by the insert
+    releaseNodes(path, true);
+    if (rootLatched) {
+        rootLatch.unlock();
     }
 }
+
 /**
- * place the newChildEntry into the NonLeaf node
- * @requires node has space
- * @param newChildEntry  PageKeyPair to be placed
- * @param node the NonLeafNode
+ * Unpin and unlatch the nodes held on a path, and empty it. Pins are dropped
+ * first so that a node a writer holds exclusive is pinned by nobody else.
+ * @param path Nodes latched on the way down
+ * @param dirty True if the nodes need to be marked dirty
  */
-// TODO: figure out whether need to care the left most pointer
-const void BTreeIndex::placeNewChild(PageKeyPair<int> &newChildEntry, NonLeafNodeInt *node) {
-    int i = 0;
-    while (node->pageNoArray[i+1] != 0 && node->keyArray[i] < newChildEntry.key) {
-        i++;
+const void BTreeIndex::releaseNodes(std::vector<LatchedNode> &path, const bool dirty) {
+    for (size_t i = 0; i < path.size(); ++i) {
+        bufMgr->unPinPage(path[i].page, dirty);
+        bufMgr->unlatchPage(path[i].page);
+    }
+    path.clear();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteEntry
+// -----------------------------------------------------------------------------
+
+const bool BTreeIndex::deleteEntry(const void *key, const RecordId rid)
+{
+    if (attributeType == DOUBLE) {
+        return deleteKey(*(double *)key, rid);
+    }
+    if (attributeType == STRING) {
+        return deleteKey(readKey<std::string>(key), rid);
     }
-    if (node->pageNoArray[i+1] == 0) {  // i is empty, place node here
-        node->pageNoArray[i+1] = newChildEntry.pageNo;
-        node->keyArray[i] = newChildEntry.key;
-    } else {    // i is the first key that greater than entryPair.key
-        int j = nodeOccupancy - 1;
-        // move all the elements after i rightforward 1
-        while (j >= i) {
-            if (node->pageNoArray[j+1] != 0) {
-                node->pageNoArray[j+2] = node->pageNoArray[j+1];
-                node->keyArray[j+1] = node->keyArray[j];
+    return deleteKey(*(int *)key, rid);
+}
+
+/**
+ * Delete the pair <key,rid> from a tree whose keys are of type T.
+ * @param key Key to delete
+ * @param rid Record ID of the record whose entry is getting deleted
+ * @return False if there is no such entry
+ */
+template <class T>
+const bool BTreeIndex::deleteKey(const T key, const RecordId rid)
+{
+    const T targetKey = key;
+    std::vector<LatchedNode> path;
+    // index of each node on the path in the pageNoArray of the node above it
+    std::vector<int> childIndexes;
+    bool rootLatched;
+    LeafNode<T> *leafNode;
+    int i;
+    // the first pass latches down to the leftmost leaf that may hold key, keeping
+    // only the nodes a merge could reach; if the leaf ends in duplicates of key the
+    // entry may be further right, and a second pass keeps the whole path so that it
+    // can be walked along the leaves holding them
+    for (int pass = 0; ; ++pass) {
+        const bool keepPath = pass > 0;
+        rootLatch.lockExclusive();
+        rootLatched = true;
+        PageId pageNo = rootPageNum;
+        bool isLeaf = rootPageNum == 2;
+        int childIndex = 0;
+        bool isRoot = true;
+        while (1) {
+            LatchedNode node;
+            node.pageNo = pageNo;
+            bufMgr->readPage(file, pageNo, node.page);
+            bufMgr->latchPage(node.page, true);
+            bool safe;
+            if (isRoot) {
+                // the root only goes when a non-leaf root is down to its last child
+                safe = isLeaf || ((NonLeafNode<T> *)node.page)->numKeys > 1;
+            } else {
+                safe = isLeaf ? ((LeafNode<T> *)node.page)->numKeys > leafOccupancy / 2
+                              : ((NonLeafNode<T> *)node.page)->numKeys > nodeOccupancy / 2;
+            }
+            if (safe && !keepPath) {
+                releaseNodes(path, false);
+                childIndexes.clear();
+                if (rootLatched) {
+                    rootLatch.unlock();
+                    rootLatched = false;
+                }
             }
-            j--;
+            path.push_back(node);
+            childIndexes.push_back(childIndex);
+            isRoot = false;
+            if (isLeaf)
+                break;
+            NonLeafNode<T> *nonLeafNode = (NonLeafNode<T> *)node.page;
+            childIndex = lowerBound(nonLeafNode->keyArray, nonLeafNode->numKeys, targetKey);
+            pageNo = nonLeafNode->pageNoArray[childIndex];
+            isLeaf = nonLeafNode->level == 1;
+        }
+        leafNode = (LeafNode<T> *)path.back().page;
+        i = findEntry(leafNode, targetKey, rid);
+        while (keepPath && i == leafNode->numKeys && nextLeaf(path, childIndexes, targetKey)) {
+            leafNode = (LeafNode<T> *)path.back().page;
+            i = findEntry(leafNode, targetKey, rid);
+        }
+        if (i < leafNode->numKeys || keepPath || leafNode->rightSibPageNo == 0)
+            break;
+        releaseNodes(path, false);
+        childIndexes.clear();
+        if (rootLatched) {
+            rootLatch.unlock();
         }
-        node->pageNoArray[i+1] = newChildEntry.pageNo;
-        node->keyArray[i] = newChildEntry.key;
+    }
+
+    // take the entry out of the leaf
+    int count = leafNode->numKeys;
+    if (i == count || leafNode->keyArray[i] != targetKey) {
+        releaseNodes(path, false);
+        if (rootLatched) {
+            rootLatch.unlock();
+        }
+        return false;
+    }
+    memmove(&leafNode->keyArray[i], &leafNode->keyArray[i+1], (count - i - 1) * sizeof(T));
+    memmove(&leafNode->ridArray[i], &leafNode->ridArray[i+1], (count - i - 1) * sizeof(RecordId));
+    leafNode->numKeys = count - 1;
+
+    // fix underflows up the latched path while merges take entries out of parents
+    int level = (int)path.size() - 1;
+    while (level > 0) {
+        bool underflow = level == (int)path.size() - 1
+            ? ((LeafNode<T> *)path[level].page)->numKeys < leafOccupancy / 2
+            : ((NonLeafNode<T> *)path[level].page)->numKeys < nodeOccupancy / 2;
+        if (!underflow ||
+            !rebalanceChild((NonLeafNode<T> *)path[level - 1].page, childIndexes[level], path[level],
+                            level == (int)path.size() - 1))
+            break;
+        --level;
+    }
+    // a non-leaf root left with one child hands over to it; rootLatch is
+    // still held only if the root heads the path
+    if (rootLatched && rootPageNum != 2 && ((NonLeafNode<T> *)path[0].page)->numKeys == 0) {
+        changeRootPageNum(((NonLeafNode<T> *)path[0].page)->pageNoArray[0]);
+        bufMgr->disposePage(file, path[0].pageNo);
+        bufMgr->unlatchPage(path[0].page);
+        path.erase(path.begin());
+    }
+    releaseNodes(path, true);
+    if (rootLatched) {
+        rootLatch.unlock();
+    }
+    return true;
+}
+
+/**
+ * Move a path held from the root down to a leaf on to the next leaf, as long as
+ * that leaf may still hold key. Nodes the path leaves behind are released unchanged,
+ * and the nodes it takes on are latched exclusive, parents first.
+ * @param path Nodes latched exclusive from the root down to a leaf
+ * @param childIndexes Index of each node on the path among the children of the node above it
+ * @param key Key being looked for
+ * @return False if no leaf to the right may hold key, in which case path is left as it is
+ */
+template <class T>
+const bool BTreeIndex::nextLeaf(std::vector<LatchedNode> &path, std::vector<int> &childIndexes, const T key) {
+    typedef typename NodeLayout<T>::NonLeaf NonLeaf;
+    // climb to the lowest node with a child right of the path
+    int level = (int)path.size() - 2;
+    while (level >= 0 && childIndexes[level + 1] == ((NonLeaf *)path[level].page)->numKeys)
+        --level;
+    // the keys of that child are no smaller than the separator in front of it
+    if (level < 0 || upperBound((NonLeaf *)path[level].page, key) <= childIndexes[level + 1])
+        return false;
+    int childIndex = childIndexes[level + 1] + 1;
+    for (size_t l = level + 1; l < path.size(); ++l) {
+        bufMgr->unPinPage(path[l].page, false);
+        bufMgr->unlatchPage(path[l].page);
+    }
+    path.resize(level + 1);
+    childIndexes.resize(level + 1);
+    // down the left edge of the child's subtree
+    while (1) {
+        NonLeaf *node = (NonLeaf *)path.back().page;
+        LatchedNode child;
+        child.pageNo = childPageNo(node, childIndex);
+        bufMgr->readPage(file, child.pageNo, child.page);
+        bufMgr->latchPage(child.page, true);
+        path.push_back(child);
+        childIndexes.push_back(childIndex);
+        if (node->level == 1)
+            return true;
+        childIndex = 0;
     }
 }
 
 /**
- * Recursive function to insert an entry into root.
- * @param isLeaf Current root is leaf or not
- * @param rootPageID PageId of current root
- * @param newChildEntry PageKeyPair used to "pop-up" if split happens
- * @param entryPair Target entry to be inserted
+ * Fix an underflowing child by borrowing entries from a sibling, or by merging
+ * the two when they fit in one node. The right sibling is used unless child is
+ * the last one, in which case child is unlatched so that its left sibling can be
+ * latched first. The sibling is released before returning, and a node emptied
+ * by a merge is disposed of; child is updated to whichever node survives.
+ * @param parent Parent of child, latched exclusive
+ * @param childIndex Index of child in the pageNoArray of parent
+ * @param child Underflowing child, latched exclusive
+ * @param isLeaf The child is a leaf or not
+ * @return True if the nodes were merged, taking an entry out of parent
  */
-const void BTreeIndex::insertEntryHelper(bool isLeaf, const PageId rootPageID,
-                                         PageKeyPair<int> &newChildEntry, RIDKeyPair<int> entryPair) {
-    Page* rootPage;
-    bufMgr->readPage(file, rootPageID, rootPage);
+template <class T>
+const bool BTreeIndex::rebalanceChild(NonLeafNode<T> *parent, const int childIndex, LatchedNode &child,
+                                      const bool isLeaf) {
+    if (parent->numKeys == 0)
+        return false;
+    LatchedNode left, right;
+    int separatorIndex;
+    if (childIndex < parent->numKeys) {
+        separatorIndex = childIndex;
+        left = child;
+        right.pageNo = parent->pageNoArray[childIndex + 1];
+        bufMgr->readPage(file, right.pageNo, right.page);
+        bufMgr->latchPage(right.page, true);
+    } else {
+        separatorIndex = childIndex - 1;
+        bufMgr->unlatchPage(child.page);
+        left.pageNo = parent->pageNoArray[separatorIndex];
+        bufMgr->readPage(file, left.pageNo, left.page);
+        bufMgr->latchPage(left.page, true);
+        bufMgr->latchPage(child.page, true);
+        right = child;
+    }
+    T separator = parent->keyArray[separatorIndex];
+    bool merge;
     if (isLeaf) {
-        // insert or split
-        LeafNodeInt* rootNode = (LeafNodeInt*)rootPage;
-        if (rootNode->ridArray[leafOccupancy - 1].page_number == 0) {  // have space
-            placeEntry(entryPair, rootNode);
-        } else {    // no space, split
-            splitLeaf(rootNode, newChildEntry, entryPair, rootPageID);
+        LeafNode<T> *leftNode = (LeafNode<T> *)left.page;
+        LeafNode<T> *rightNode = (LeafNode<T> *)right.page;
+        merge = leftNode->numKeys + rightNode->numKeys <= leafOccupancy;
+        if (merge) {
+            mergeLeaves(leftNode, rightNode);
+        } else {
+            parent->keyArray[separatorIndex] = redistributeLeaves(leftNode, rightNode);
         }
     } else {
-        // continue searching
-        NonLeafNodeInt* nonLeafNode = (NonLeafNodeInt*)rootPage;
-        int i = 0;
-        for (; i < nodeOccupancy && nonLeafNode->pageNoArray[i+1] != 0; ++i) {
-            if (entryPair.key < nonLeafNode->keyArray[i]) { // in this subtree
-                break;
-            }
-        }
-        insertEntryHelper(nonLeafNode->level, nonLeafNode->pageNoArray[i],
-                newChildEntry, entryPair);
-        if (newChildEntry.pageNo != 0) {  // subtree got split
-            int j = 0;
-            for(; j < nodeOccupancy && nonLeafNode->pageNoArray[j+1] != 0; ++j);
-            bool nodeFull = j == nodeOccupancy;
-            if (!nodeFull) {
-//                put *newchildentry on it, set newchildentry to null
-                placeNewChild(newChildEntry, nonLeafNode);
-                newChildEntry.set(0, 0);
-            } else {
-                // split
-                splitNonLeaf(nonLeafNode, rootPageID, newChildEntry);
-                // newChildEntry point to smallest key on second half
-            }
+        NonLeafNode<T> *leftNode = (NonLeafNode<T> *)left.page;
+        NonLeafNode<T> *rightNode = (NonLeafNode<T> *)right.page;
+        merge = leftNode->numKeys + rightNode->numKeys + 1 <= nodeOccupancy;
+        if (merge) {
+            mergeNonLeaves(leftNode, rightNode, separator);
+        } else {
+            parent->keyArray[separatorIndex] = redistributeNonLeaves(leftNode, rightNode, separator);
         }
     }
-    bufMgr->unPinPage(file, rootPageID, true);
+    if (merge) {
+        removeChild(parent, separatorIndex);
+        // nobody else can hold a pin on right, so it is safe to hand back to the file
+        bufMgr->disposePage(file, right.pageNo);
+        bufMgr->unlatchPage(right.page);
+        child = left;
+    } else {
+        LatchedNode sibling = child.pageNo == left.pageNo ? right : left;
+        bufMgr->unPinPage(sibling.page, true);
+        bufMgr->unlatchPage(sibling.page);
+    }
+    return merge;
+}
+
+/**
+ * Take a key and the child to its right out of a non-leaf node.
+ * @param node The NonLeafNode
+ * @param keyIndex Index of the key to remove
+ */
+template <class T>
+const void BTreeIndex::removeChild(NonLeafNode<T> *node, const int keyIndex) {
+    int count = node->numKeys;
+    memmove(&node->keyArray[keyIndex], &node->keyArray[keyIndex+1], (count - keyIndex - 1) * sizeof(T));
+    memmove(&node->pageNoArray[keyIndex+1], &node->pageNoArray[keyIndex+2], (count - keyIndex - 1) * sizeof(PageId));
+    node->numKeys = count - 1;
+}
+
+/**
+ * Append all entries of a leaf to its left sibling, and unlink it from the leaf chain.
+ * @requires both fit in one leaf
+ * @param left Leaf kept
+ * @param right Leaf emptied
+ */
+template <class T>
+const void BTreeIndex::mergeLeaves(LeafNode<T> *left, LeafNode<T> *right) {
+    memcpy(&left->keyArray[left->numKeys], &right->keyArray[0], right->numKeys * sizeof(T));
+    memcpy(&left->ridArray[left->numKeys], &right->ridArray[0], right->numKeys * sizeof(RecordId));
+    left->numKeys += right->numKeys;
+    left->rightSibPageNo = right->rightSibPageNo;
+    right->numKeys = 0;
+}
+
+/**
+ * Move entries between two neighbouring leaves so that they hold half each.
+ * @param left Left leaf
+ * @param right Right leaf
+ * @return New separator key, the smallest key in right
+ */
+template <class T>
+const T BTreeIndex::redistributeLeaves(LeafNode<T> *left, LeafNode<T> *right) {
+    int leftCount = (left->numKeys + right->numKeys) / 2;
+    if (left->numKeys > leftCount) {
+        int moveCount = left->numKeys - leftCount;
+        memmove(&right->keyArray[moveCount], &right->keyArray[0], right->numKeys * sizeof(T));
+        memmove(&right->ridArray[moveCount], &right->ridArray[0], right->numKeys * sizeof(RecordId));
+        memcpy(&right->keyArray[0], &left->keyArray[leftCount], moveCount * sizeof(T));
+        memcpy(&right->ridArray[0], &left->ridArray[leftCount], moveCount * sizeof(RecordId));
+        right->numKeys += moveCount;
+    } else {
+        int moveCount = leftCount - left->numKeys;
+        memcpy(&left->keyArray[left->numKeys], &right->keyArray[0], moveCount * sizeof(T));
+        memcpy(&left->ridArray[left->numKeys], &right->ridArray[0], moveCount * sizeof(RecordId));
+        right->numKeys -= moveCount;
+        memmove(&right->keyArray[0], &right->keyArray[moveCount], right->numKeys * sizeof(T));
+        memmove(&right->ridArray[0], &right->ridArray[moveCount], right->numKeys * sizeof(RecordId));
+    }
+    left->numKeys = leftCount;
+    return right->keyArray[0];
+}
+
+/**
+ * Append the separator and all keys and children of a non-leaf node to its left sibling.
+ * @requires both fit in one node together with the separator
+ * @param left Node kept
+ * @param right Node emptied
+ * @param separator Key between left and right in their parent
+ */
+template <class T>
+const void BTreeIndex::mergeNonLeaves(NonLeafNode<T> *left, NonLeafNode<T> *right, const T separator) {
+    left->keyArray[left->numKeys] = separator;
+    memcpy(&left->keyArray[left->numKeys + 1], &right->keyArray[0], right->numKeys * sizeof(T));
+    memcpy(&left->pageNoArray[left->numKeys + 1], &right->pageNoArray[0], (right->numKeys + 1) * sizeof(PageId));
+    left->numKeys += right->numKeys + 1;
+    right->numKeys = 0;
+}
+
+/**
+ * Rotate keys and children between two neighbouring non-leaf nodes through
+ * their separator so that they hold half each.
+ * @param left Left node
+ * @param right Right node
+ * @param separator Key between left and right in their parent
+ * @return New separator key
+ */
+template <class T>
+const T BTreeIndex::redistributeNonLeaves(NonLeafNode<T> *left, NonLeafNode<T> *right, const T separator) {
+    int leftCount = (left->numKeys + right->numKeys) / 2;
+    if (left->numKeys == leftCount)
+        return separator;
+    T newSeparator;
+    if (left->numKeys > leftCount) {
+        // the separator comes down into right along with the last keys of left
+        int moveCount = left->numKeys - leftCount;
+        memmove(&right->keyArray[moveCount], &right->keyArray[0], right->numKeys * sizeof(T));
+        memmove(&right->pageNoArray[moveCount], &right->pageNoArray[0], (right->numKeys + 1) * sizeof(PageId));
+        right->keyArray[moveCount - 1] = separator;
+        memcpy(&right->keyArray[0], &left->keyArray[leftCount + 1], (moveCount - 1) * sizeof(T));
+        memcpy(&right->pageNoArray[0], &left->pageNoArray[leftCount + 1], moveCount * sizeof(PageId));
+        newSeparator = left->keyArray[leftCount];
+        right->numKeys += moveCount;
+    } else {
+        // the separator comes down into left along with the first keys of right
+        int moveCount = leftCount - left->numKeys;
+        left->keyArray[left->numKeys] = separator;
+        memcpy(&left->keyArray[left->numKeys + 1], &right->keyArray[0], (moveCount - 1) * sizeof(T));
+        memcpy(&left->pageNoArray[left->numKeys + 1], &right->pageNoArray[0], moveCount * sizeof(PageId));
+        newSeparator = right->keyArray[moveCount - 1];
+        right->numKeys -= moveCount;
+        memmove(&right->keyArray[0], &right->keyArray[moveCount], right->numKeys * sizeof(T));
+        memmove(&right->pageNoArray[0], &right->pageNoArray[moveCount], (right->numKeys + 1) * sizeof(PageId));
+    }
+    left->numKeys = leftCount;
+    return newSeparator;
+}
+
+/**
+ * place the entryPair in the recurrent Leaf node
+ * @requires node has space
+ * @param entryPair the record-key pair to be placed
+ * @param node the leaf node
+ */
+template <class T>
+const void BTreeIndex::placeEntry(RIDKeyPair<T> entryPair, LeafNode<T> *node) {
+    int count = node->numKeys;
+    int i = lowerBound(node->keyArray, count, entryPair.key);
+    // move all the elements from i rightforward 1
+    memmove(&node->keyArray[i+1], &node->keyArray[i], (count - i) * sizeof(T));
+    memmove(&node->ridArray[i+1], &node->ridArray[i], (count - i) * sizeof(RecordId));
+    node->keyArray[i] = entryPair.key;
+    node->ridArray[i] = entryPair.rid;
+    node->numKeys = count + 1;
 }
+/**
+ * place the newChildEntry into the NonLeaf node, right after the child it was split
+ * from. Duplicates can give several children the same separator, so the key alone
+ * does not tell where the new child goes among them.
+ * @requires node has space
+ * @param newChildEntry  PageKeyPair to be placed
+ * @param node the NonLeafNode
+ * @param childIndex Index in pageNoArray of the child that was split
+ */
+template <class T>
+const void BTreeIndex::placeNewChild(PageKeyPair<T> &newChildEntry, NonLeafNode<T> *node, const int childIndex) {
+    int count = node->numKeys;
+    int i = childIndex;
+    // move all the keys from i and the children after them rightforward 1
+    memmove(&node->keyArray[i+1], &node->keyArray[i], (count - i) * sizeof(T));
+    memmove(&node->pageNoArray[i+2], &node->pageNoArray[i+1], (count - i) * sizeof(PageId));
+    node->keyArray[i] = newChildEntry.key;
+    node->pageNoArray[i+1] = newChildEntry.pageNo;
+    node->numKeys = count + 1;
+}
+
 /**
  * Split NonLeafNode into two NonLeafNode
  * @param leftNonLeafNode The old NonLeafNode to be split
  * @param leftPageId PageId of the old NonLeafNode
  * @param newChildEntry PageKeyPair of the new allocated node to be pushed up
+ * @param childIndex Index in pageNoArray of the child whose split produced newChildEntry
  */
+template <class T>
 const void
-BTreeIndex::splitNonLeaf(NonLeafNodeInt *leftNonLeafNode, PageId leftPageId, PageKeyPair<int> &newChildEntry) {
+BTreeIndex::splitNonLeaf(NonLeafNode<T> *leftNonLeafNode, PageId leftPageId, PageKeyPair<T> &newChildEntry,
+                         const int childIndex) {
     PageId rightPagId;
     Page* rightPage;
     bufMgr->allocPage(file, rightPagId, rightPage);
     memset(rightPage, 0, rightPage->SIZE);
-    NonLeafNodeInt *rightNonLeafNode = (NonLeafNodeInt *) rightPage;
-    int newEntryIndex = 0;
-    while (newEntryIndex < nodeOccupancy && leftNonLeafNode->keyArray[newEntryIndex] < newChildEntry.key)
-        ++newEntryIndex;
+    NonLeafNode<T> *rightNonLeafNode = (NonLeafNode<T> *) rightPage;
+    PageKeyPair<T> newEntry = newChildEntry;
+    int newEntryIndex = childIndex;
+    // left keeps half keys, the next one is pushed up and right gets the rest
     int half = (nodeOccupancy + 1) / 2;
-    int keyArray[nodeOccupancy + 1];
-    PageId pidArray[nodeOccupancy + 2];
-    // construct leftNode and newChildEntry into one single array, and set second half to 0
-    // left.pageNo[0] does not need to change!
-    pidArray[0] = leftNonLeafNode->pageNoArray[0];
-    for (int i = 0, j = 0; i < nodeOccupancy + 1; ++i, ++j) {
-        if (i == newEntryIndex) {
-            keyArray[i] = newChildEntry.key;
-            pidArray[i+1] = newChildEntry.pageNo;
-            --j;
-            continue;
-        }
-        keyArray[i] = leftNonLeafNode->keyArray[j];
-        pidArray[i+1] = leftNonLeafNode->pageNoArray[j+1];
-        if (i >= half) {
-            leftNonLeafNode->keyArray[j] = 0;
-            leftNonLeafNode->pageNoArray[j+1] = 0;
-        }
-    }
-    // if newChildEntry should be in left, then the following set it
-    for (int i = 0; i < half; ++i) {
-        leftNonLeafNode->keyArray[i] = keyArray[i];
-        leftNonLeafNode->pageNoArray[i+1] = pidArray[i+1];
-    }
-    // set newChildEntry
-    newChildEntry.set(rightPagId, keyArray[half]);
-    rightNonLeafNode->pageNoArray[0] = pidArray[half+1];
-    ++half; // TODO: skip the half one(smallest on right), push up!
-    // construct newLeafNode
-    for (int i = 0; half < nodeOccupancy + 1; ++i, ++half) {
-        rightNonLeafNode->keyArray[i] = keyArray[half];
-        rightNonLeafNode->pageNoArray[i+1] = pidArray[half+1];
+    // index in left of the first key (and the child after it) moved to right
+    int moveFrom = newEntryIndex <= half ? half : half + 1;
+    int moveCount = nodeOccupancy - moveFrom;
+    if (newEntryIndex < half) {
+        // pushed up key is the last one staying in left before newEntry is placed there
+        newChildEntry.set(rightPagId, leftNonLeafNode->keyArray[half - 1]);
+        rightNonLeafNode->pageNoArray[0] = leftNonLeafNode->pageNoArray[half];
+    } else if (newEntryIndex == half) {
+        newChildEntry.set(rightPagId, newEntry.key);
+        rightNonLeafNode->pageNoArray[0] = newEntry.pageNo;
+    } else {
+        newChildEntry.set(rightPagId, leftNonLeafNode->keyArray[half]);
+        rightNonLeafNode->pageNoArray[0] = leftNonLeafNode->pageNoArray[half + 1];
+    }
+    memcpy(&rightNonLeafNode->keyArray[0], &leftNonLeafNode->keyArray[moveFrom], moveCount * sizeof(T));
+    memcpy(&rightNonLeafNode->pageNoArray[1], &leftNonLeafNode->pageNoArray[moveFrom + 1], moveCount * sizeof(PageId));
+    rightNonLeafNode->numKeys = moveCount;
+    leftNonLeafNode->numKeys = newEntryIndex < half ? half - 1 : half;
+    if (newEntryIndex < half) {
+        placeNewChild(newEntry, leftNonLeafNode, newEntryIndex);
+    } else if (newEntryIndex > half) {
+        placeNewChild(newEntry, rightNonLeafNode, newEntryIndex - moveFrom);
     }
     if (leftNonLeafNode->level == 1)
         rightNonLeafNode->level = 1;
@@ -325,16 +1054,17 @@ BTreeIndex::splitNonLeaf(NonLeafNodeInt *leftNonLeafNode, PageId leftPageId, Pag
         Page *newPage;
         bufMgr->allocPage(file, newPageID, newPage);
         memset(newPage, 0, newPage->SIZE);
-        NonLeafNodeInt *realRoot = (NonLeafNodeInt *)newPage;
+        NonLeafNode<T> *realRoot = (NonLeafNode<T> *)newPage;
         realRoot->level = 0;
+        realRoot->numKeys = 1;
         realRoot->keyArray[0] = newChildEntry.key;
         realRoot->pageNoArray[0] = leftPageId;
         realRoot->pageNoArray[1] = rightPagId;
         changeRootPageNum(newPageID);
         newChildEntry.set(0, 0);
-        bufMgr->unPinPage(file, newPageID, true);
+        bufMgr->unPinPage(newPage, true);
     }
-    bufMgr->unPinPage(file, rightPagId, true);
+    bufMgr->unPinPage(rightPage, true);
 }
 
 /**
@@ -345,44 +1075,27 @@ BTreeIndex::splitNonLeaf(NonLeafNodeInt *leftNonLeafNode, PageId leftPageId, Pag
  * @param entryPair The new inserted data
  * @param leftPageId PageId of left leaf
  */
-const void BTreeIndex::splitLeaf(LeafNodeInt *leftLeafNode, PageKeyPair<int> &newChildEntry, RIDKeyPair<int> entryPair,
+template <class T>
+const void BTreeIndex::splitLeaf(LeafNode<T> *leftLeafNode, PageKeyPair<T> &newChildEntry, RIDKeyPair<T> entryPair,
                                  PageId leftPageId) {
     PageId rightPageID;
     Page* rightPage;
     bufMgr->allocPage(file, rightPageID, rightPage);
     memset(rightPage, 0, rightPage->SIZE);
-    LeafNodeInt *rightLeafNode = (LeafNodeInt *)rightPage;
-    int newEntryIndex = 0;
-    while (newEntryIndex < leafOccupancy && leftLeafNode->keyArray[newEntryIndex] < entryPair.key)
-        ++newEntryIndex;
+    LeafNode<T> *rightLeafNode = (LeafNode<T> *)rightPage;
+    int newEntryIndex = lowerBound(leftLeafNode->keyArray, leafOccupancy, entryPair.key);
+    // left ends up with half entries and right with the rest, counting entryPair
     int half = (leafOccupancy + 1) / 2;
-    int keyArray[leafOccupancy + 1];
-    RecordId ridArray[leafOccupancy + 1];
-    // construct oldLeaf and entryPair into one single array, and set second half to 0
-    for (int i = 0, j = 0; i < leafOccupancy + 1; ++i, ++j) {
-        if (i == newEntryIndex) {
-            keyArray[i] = entryPair.key;
-            ridArray[i] = entryPair.rid;
-            --j;
-            continue;
-        }
-        keyArray[i] = leftLeafNode->keyArray[j];
-        ridArray[i] = leftLeafNode->ridArray[j];
-        if (i >= half) {
-            leftLeafNode->keyArray[j] = 0;
-            leftLeafNode->ridArray[j].page_number = 0;
-            leftLeafNode->ridArray[j].slot_number = 0;
-        }
-    }
-    // if entryPair should be in oldLeaf, then the following set it
-    for (int i = 0; i < half; ++i) {
-        leftLeafNode->keyArray[i] = keyArray[i];
-        leftLeafNode->ridArray[i] = ridArray[i];
-    }
-    // construct newLeafNode
-    for (int i = 0; half < leafOccupancy + 1; ++i, ++half) {
-        rightLeafNode->keyArray[i] = keyArray[half];
-        rightLeafNode->ridArray[i] = ridArray[half];
+    int moveFrom = newEntryIndex < half ? half - 1 : half;
+    int moveCount = leafOccupancy - moveFrom;
+    memcpy(&rightLeafNode->keyArray[0], &leftLeafNode->keyArray[moveFrom], moveCount * sizeof(T));
+    memcpy(&rightLeafNode->ridArray[0], &leftLeafNode->ridArray[moveFrom], moveCount * sizeof(RecordId));
+    rightLeafNode->numKeys = moveCount;
+    leftLeafNode->numKeys = moveFrom;
+    if (newEntryIndex < half) {
+        placeEntry(entryPair, leftLeafNode);
+    } else {
+        placeEntry(entryPair, rightLeafNode);
     }
     rightLeafNode->rightSibPageNo = leftLeafNode->rightSibPageNo;
     // set newChildEntry and sibling pointer
@@ -396,16 +1109,384 @@ const void BTreeIndex::splitLeaf(LeafNodeInt *leftLeafNode, PageKeyPair<int> &ne
         Page *newPage;
         bufMgr->allocPage(file, newPageID, newPage);
         memset(newPage, 0, newPage->SIZE);
-        NonLeafNodeInt *realRoot = (NonLeafNodeInt *)newPage;
+        NonLeafNode<T> *realRoot = (NonLeafNode<T> *)newPage;
         realRoot->level = 1;
+        realRoot->numKeys = 1;
         realRoot->keyArray[0] = newChildEntry.key;
         realRoot->pageNoArray[0] = leftPageId;
         realRoot->pageNoArray[1] = rightPageID;
         changeRootPageNum(newPageID);
         newChildEntry.set(0, 0);
-        bufMgr->unPinPage(file, newPageID, true);
+        bufMgr->unPinPage(newPage, true);
     }
-    bufMgr->unPinPage(file, rightPageID, true);
+    bufMgr->unPinPage(rightPage, true);
+}
+
+/**
+ * Insert the pair <key,rid> into a tree with STRING keys. The descent is the same
+ * as for the other key types, except that whether a node has room is decided by
+ * bytes: a leaf must fit the new entry, a non-leaf any separator up to STRINGSIZE
+ * long. Sizes are taken as if the node shared no prefix, since the new key may
+ * shorten it.
+ * @param key Key to insert
+ * @param rid Record ID of the record whose entry is getting inserted
+ */
+template <>
+const void BTreeIndex::insertKey<std::string>(const std::string key, const RecordId rid)
+{
+    const int entrySize = sizeof(StringLeafSlot) + key.size();
+    const int separatorSize = sizeof(StringNonLeafSlot) + STRINGSIZE;
+    std::vector<LatchedNode> path;
+    std::vector<int> childIndexes;
+    rootLatch.lockExclusive();
+    bool rootLatched = true;
+    PageId pageNo = rootPageNum;
+    bool isLeaf = rootPageNum == 2;
+    int childIndex = 0;
+    while (1) {
+        LatchedNode node;
+        node.pageNo = pageNo;
+        bufMgr->readPage(file, pageNo, node.page);
+        bufMgr->latchPage(node.page, true);
+        bool safe = isLeaf ? stringLeafSize((StringLeafNode *)node.page, true) + entrySize <= (int)Page::SIZE
+                           : stringNonLeafSize((StringNonLeafNode *)node.page, true) + separatorSize <= (int)Page::SIZE;
+        if (safe) {
+            releaseNodes(path, false);
+            childIndexes.clear();
+            if (rootLatched) {
+                rootLatch.unlock();
+                rootLatched = false;
+            }
+        }
+        path.push_back(node);
+        childIndexes.push_back(childIndex);
+        if (isLeaf)
+            break;
+        StringNonLeafNode *nonLeafNode = (StringNonLeafNode *)node.page;
+        childIndex = upperBound(nonLeafNode, key);
+        pageNo = childPageNo(nonLeafNode, childIndex);
+        isLeaf = nonLeafNode->level == 1;
+    }
+
+    PageKeyPair<std::string> newChildEntry;
+    newChildEntry.set(0, "");
+    insertStringLeaf(path.back(), key, rid, newChildEntry);
+    for (int i = (int)path.size() - 2; i >= 0 && newChildEntry.pageNo != 0; --i) {
+        insertStringNonLeaf(path[i], newChildEntry, childIndexes[i + 1]);
+    }
+    releaseNodes(path, true);
+    if (rootLatched) {
+        rootLatch.unlock();
+    }
+}
+
+/**
+ * Place an entry in a STRING leaf, splitting it when the entry does not fit.
+ * The entry goes in place when its key starts with the prefix of the leaf;
+ * otherwise the leaf is rewritten. A split divides the leaf by bytes, and copies
+ * up the shortest separator between the two halves.
+ * @param leaf The leaf, latched exclusive
+ * @param key Key to insert
+ * @param rid Record ID of the record whose entry is getting inserted
+ * @param newChildEntry Returns the separator and pageNo of the new right leaf if
+ * the leaf was split below the root, and is left alone otherwise
+ */
+const void BTreeIndex::insertStringLeaf(LatchedNode &leaf, const std::string &key, const RecordId rid,
+                                        PageKeyPair<std::string> &newChildEntry) {
+    StringLeafNode *leftLeafNode = (StringLeafNode *)leaf.page;
+    int i = lowerBound(leftLeafNode, key);
+    if (insertStringLeafEntry(leftLeafNode, i, key, rid))
+        return;
+    std::vector<std::string> keys;
+    std::vector<RecordId> rids;
+    decodeStringLeaf(leftLeafNode, keys, rids);
+    keys.insert(keys.begin() + i, key);
+    rids.insert(rids.begin() + i, rid);
+    if (encodeStringLeaf(leftLeafNode, keys, rids, 0, keys.size()))
+        return;
+    int split = stringSplitPoint(keys, true);
+    PageId rightPageID;
+    Page *rightPage;
+    bufMgr->allocPage(file, rightPageID, rightPage);
+    memset(rightPage, 0, rightPage->SIZE);
+    StringLeafNode *rightLeafNode = (StringLeafNode *)rightPage;
+    encodeStringLeaf(leftLeafNode, keys, rids, 0, split);
+    encodeStringLeaf(rightLeafNode, keys, rids, split, keys.size());
+    rightLeafNode->rightSibPageNo = leftLeafNode->rightSibPageNo;
+    leftLeafNode->rightSibPageNo = rightPageID;
+    newChildEntry.set(rightPageID, truncatedSeparator(keys[split - 1], keys[split]));
+    if (leaf.pageNo == rootPageNum) {
+        growStringRoot(leaf.pageNo, newChildEntry, 1);
+    }
+    bufMgr->unPinPage(rightPage, true);
+}
+
+/**
+ * Place a separator and the child to its right in a STRING non-leaf, right after the
+ * child they were split from, splitting the non-leaf when they do not fit. A split
+ * divides the node by bytes and pushes its middle key up.
+ * @param node The non-leaf, latched exclusive
+ * @param newChildEntry Separator and pageNo to place; returns the key pushed up and
+ * the pageNo of the new right node if the node was split below the root, and is
+ * reset otherwise
+ * @param childIndex Index among the children of node of the child that was split
+ */
+const void BTreeIndex::insertStringNonLeaf(LatchedNode &node, PageKeyPair<std::string> &newChildEntry,
+                                           const int childIndex) {
+    StringNonLeafNode *leftNonLeafNode = (StringNonLeafNode *)node.page;
+    std::vector<std::string> keys;
+    std::vector<PageId> pageNos;
+    decodeStringNonLeaf(leftNonLeafNode, keys, pageNos);
+    int i = childIndex;
+    keys.insert(keys.begin() + i, newChildEntry.key);
+    pageNos.insert(pageNos.begin() + i + 1, newChildEntry.pageNo);
+    if (encodeStringNonLeaf(leftNonLeafNode, keys, pageNos, 0, keys.size())) {
+        newChildEntry.set(0, "");
+        return;
+    }
+    int split = stringSplitPoint(keys, false);
+    PageId rightPageID;
+    Page *rightPage;
+    bufMgr->allocPage(file, rightPageID, rightPage);
+    memset(rightPage, 0, rightPage->SIZE);
+    StringNonLeafNode *rightNonLeafNode = (StringNonLeafNode *)rightPage;
+    rightNonLeafNode->level = leftNonLeafNode->level;
+    encodeStringNonLeaf(leftNonLeafNode, keys, pageNos, 0, split);
+    encodeStringNonLeaf(rightNonLeafNode, keys, pageNos, split + 1, keys.size());
+    newChildEntry.set(rightPageID, keys[split]);
+    if (node.pageNo == rootPageNum) {
+        growStringRoot(node.pageNo, newChildEntry, 0);
+    }
+    bufMgr->unPinPage(rightPage, true);
+}
+
+/**
+ * Put a new STRING root above the two halves of a root that was just split.
+ * @param leftPageNo PageId of the old root, which kept the left half
+ * @param newChildEntry Separator and pageNo of the right half; reset, as nothing is left to insert
+ * @param level Level of the new root, 1 if the old root was a leaf
+ */
+const void BTreeIndex::growStringRoot(const PageId leftPageNo, PageKeyPair<std::string> &newChildEntry,
+                                      const int level) {
+    PageId newPageID;
+    Page *newPage;
+    bufMgr->allocPage(file, newPageID, newPage);
+    memset(newPage, 0, newPage->SIZE);
+    StringNonLeafNode *realRoot = (StringNonLeafNode *)newPage;
+    realRoot->level = level;
+    std::vector<std::string> keys(1, newChildEntry.key);
+    std::vector<PageId> pageNos;
+    pageNos.push_back(leftPageNo);
+    pageNos.push_back(newChildEntry.pageNo);
+    encodeStringNonLeaf(realRoot, keys, pageNos, 0, 1);
+    changeRootPageNum(newPageID);
+    newChildEntry.set(0, "");
+    bufMgr->unPinPage(newPage, true);
+}
+
+/**
+ * Delete the pair <key,rid> from a tree with STRING keys. Nodes are measured in
+ * bytes as if they shared no prefix, so removing an entry always shrinks a node
+ * by the size of that entry: a node is short once under half a page, and a node
+ * stays safe if losing the largest entry the delete could take from it leaves it
+ * at least half full.
+ * @param key Key to delete
+ * @param rid Record ID of the record whose entry is getting deleted
+ * @return False if there is no such entry
+ */
+template <>
+const bool BTreeIndex::deleteKey<std::string>(const std::string key, const RecordId rid)
+{
+    const int entrySize = sizeof(StringLeafSlot) + key.size();
+    const int separatorSize = sizeof(StringNonLeafSlot) + STRINGSIZE;
+    std::vector<LatchedNode> path;
+    std::vector<int> childIndexes;
+    bool rootLatched;
+    StringLeafNode *leafNode;
+    int i;
+    // as for the other key types, a second pass keeping the whole path walks
+    // along the leaves holding duplicates of key
+    for (int pass = 0; ; ++pass) {
+        const bool keepPath = pass > 0;
+        rootLatch.lockExclusive();
+        rootLatched = true;
+        PageId pageNo = rootPageNum;
+        bool isLeaf = rootPageNum == 2;
+        int childIndex = 0;
+        bool isRoot = true;
+        while (1) {
+            LatchedNode node;
+            node.pageNo = pageNo;
+            bufMgr->readPage(file, pageNo, node.page);
+            bufMgr->latchPage(node.page, true);
+            bool safe;
+            if (isRoot) {
+                safe = isLeaf || ((StringNonLeafNode *)node.page)->numKeys > 1;
+            } else {
+                safe = isLeaf ? stringLeafSize((StringLeafNode *)node.page, true) - entrySize >= (int)Page::SIZE / 2
+                              : stringNonLeafSize((StringNonLeafNode *)node.page, true) - separatorSize >= (int)Page::SIZE / 2;
+            }
+            if (safe && !keepPath) {
+                releaseNodes(path, false);
+                childIndexes.clear();
+                if (rootLatched) {
+                    rootLatch.unlock();
+                    rootLatched = false;
+                }
+            }
+            path.push_back(node);
+            childIndexes.push_back(childIndex);
+            isRoot = false;
+            if (isLeaf)
+                break;
+            StringNonLeafNode *nonLeafNode = (StringNonLeafNode *)node.page;
+            childIndex = lowerBound(nonLeafNode, key);
+            pageNo = childPageNo(nonLeafNode, childIndex);
+            isLeaf = nonLeafNode->level == 1;
+        }
+        leafNode = (StringLeafNode *)path.back().page;
+        i = findEntry(leafNode, key, rid);
+        while (keepPath && i == leafNode->numKeys && nextLeaf(path, childIndexes, key)) {
+            leafNode = (StringLeafNode *)path.back().page;
+            i = findEntry(leafNode, key, rid);
+        }
+        if (i < leafNode->numKeys || keepPath || leafNode->rightSibPageNo == 0)
+            break;
+        releaseNodes(path, false);
+        childIndexes.clear();
+        if (rootLatched) {
+            rootLatch.unlock();
+        }
+    }
+
+    int count = leafNode->numKeys;
+    if (i == count || compareStringKey(leafNode, i, key) != 0) {
+        releaseNodes(path, false);
+        if (rootLatched) {
+            rootLatch.unlock();
+        }
+        return false;
+    }
+    removeStringLeafEntry(leafNode, i);
+
+    int level = (int)path.size() - 1;
+    while (level > 0) {
+        bool underflow = level == (int)path.size() - 1
+            ? stringLeafSize((StringLeafNode *)path[level].page, true) < (int)Page::SIZE / 2
+            : stringNonLeafSize((StringNonLeafNode *)path[level].page, true) < (int)Page::SIZE / 2;
+        if (!underflow ||
+            !rebalanceStringChild((StringNonLeafNode *)path[level - 1].page, childIndexes[level], path[level],
+                                  level == (int)path.size() - 1))
+            break;
+        --level;
+    }
+    if (rootLatched && rootPageNum != 2 && ((StringNonLeafNode *)path[0].page)->numKeys == 0) {
+        changeRootPageNum(((StringNonLeafNode *)path[0].page)->firstPageNo);
+        bufMgr->disposePage(file, path[0].pageNo);
+        bufMgr->unlatchPage(path[0].page);
+        path.erase(path.begin());
+    }
+    releaseNodes(path, true);
+    if (rootLatched) {
+        rootLatch.unlock();
+    }
+    return true;
+}
+
+/**
+ * Fix a short STRING child the way rebalanceChild does for the other key types.
+ * The two nodes are merged when their entries fit in one page, and otherwise
+ * split again by bytes. Borrowing changes the separator in parent, which may
+ * then grow; if parent has no room for it, the nodes are left as they are.
+ * @param parent Parent of child, latched exclusive
+ * @param childIndex Index of child among the children of parent
+ * @param child Short child, latched exclusive
+ * @param isLeaf The child is a leaf or not
+ * @return True if the nodes were merged, taking an entry out of parent
+ */
+const bool BTreeIndex::rebalanceStringChild(StringNonLeafNode *parent, const int childIndex, LatchedNode &child,
+                                            const bool isLeaf) {
+    if (parent->numKeys == 0)
+        return false;
+    LatchedNode left, right;
+    int separatorIndex;
+    if (childIndex < parent->numKeys) {
+        separatorIndex = childIndex;
+        left = child;
+        right.pageNo = childPageNo(parent, childIndex + 1);
+        bufMgr->readPage(file, right.pageNo, right.page);
+        bufMgr->latchPage(right.page, true);
+    } else {
+        separatorIndex = childIndex - 1;
+        bufMgr->unlatchPage(child.page);
+        left.pageNo = childPageNo(parent, separatorIndex);
+        bufMgr->readPage(file, left.pageNo, left.page);
+        bufMgr->latchPage(left.page, true);
+        bufMgr->latchPage(child.page, true);
+        right = child;
+    }
+    std::vector<std::string> parentKeys;
+    std::vector<PageId> parentPageNos;
+    decodeStringNonLeaf(parent, parentKeys, parentPageNos);
+    bool merge;
+    if (isLeaf) {
+        StringLeafNode *leftNode = (StringLeafNode *)left.page;
+        StringLeafNode *rightNode = (StringLeafNode *)right.page;
+        std::vector<std::string> keys, rightKeys;
+        std::vector<RecordId> rids, rightRids;
+        decodeStringLeaf(leftNode, keys, rids);
+        decodeStringLeaf(rightNode, rightKeys, rightRids);
+        keys.insert(keys.end(), rightKeys.begin(), rightKeys.end());
+        rids.insert(rids.end(), rightRids.begin(), rightRids.end());
+        merge = encodeStringLeaf(leftNode, keys, rids, 0, keys.size());
+        if (merge) {
+            leftNode->rightSibPageNo = rightNode->rightSibPageNo;
+            rightNode->numKeys = 0;
+        } else {
+            int split = stringSplitPoint(keys, true);
+            parentKeys[separatorIndex] = truncatedSeparator(keys[split - 1], keys[split]);
+            if (encodeStringNonLeaf(parent, parentKeys, parentPageNos, 0, parentKeys.size())) {
+                encodeStringLeaf(leftNode, keys, rids, 0, split);
+                encodeStringLeaf(rightNode, keys, rids, split, keys.size());
+            }
+        }
+    } else {
+        StringNonLeafNode *leftNode = (StringNonLeafNode *)left.page;
+        StringNonLeafNode *rightNode = (StringNonLeafNode *)right.page;
+        std::vector<std::string> keys, rightKeys;
+        std::vector<PageId> pageNos, rightPageNos;
+        decodeStringNonLeaf(leftNode, keys, pageNos);
+        decodeStringNonLeaf(rightNode, rightKeys, rightPageNos);
+        // the separator comes down between the keys of left and right
+        keys.push_back(parentKeys[separatorIndex]);
+        keys.insert(keys.end(), rightKeys.begin(), rightKeys.end());
+        pageNos.insert(pageNos.end(), rightPageNos.begin(), rightPageNos.end());
+        merge = encodeStringNonLeaf(leftNode, keys, pageNos, 0, keys.size());
+        if (merge) {
+            rightNode->numKeys = 0;
+        } else {
+            int split = stringSplitPoint(keys, false);
+            parentKeys[separatorIndex] = keys[split];
+            if (encodeStringNonLeaf(parent, parentKeys, parentPageNos, 0, parentKeys.size())) {
+                encodeStringNonLeaf(leftNode, keys, pageNos, 0, split);
+                encodeStringNonLeaf(rightNode, keys, pageNos, split + 1, keys.size());
+            }
+        }
+    }
+    if (merge) {
+        parentKeys.erase(parentKeys.begin() + separatorIndex);
+        parentPageNos.erase(parentPageNos.begin() + separatorIndex + 1);
+        encodeStringNonLeaf(parent, parentKeys, parentPageNos, 0, parentKeys.size());
+        // nobody else can hold a pin on right, so it is safe to hand back to the file
+        bufMgr->disposePage(file, right.pageNo);
+        bufMgr->unlatchPage(right.page);
+        child = left;
+    } else {
+        LatchedNode sibling = child.pageNo == left.pageNo ? right : left;
+        bufMgr->unPinPage(sibling.page, true);
+        bufMgr->unlatchPage(sibling.page);
+    }
+    return merge;
 }
 
 /**
@@ -413,50 +1494,118 @@ const void BTreeIndex::splitLeaf(LeafNodeInt *leftLeafNode, PageKeyPair<int> &ne
  * @param root Root of the tree
  * @return Smallest key inside root
  */
-const int BTreeIndex::findSmallestKey(NonLeafNodeInt *root) {
+template <class T>
+const T BTreeIndex::findSmallestKey(NonLeafNode<T> *root) {
     PageId targetPageId = root->pageNoArray[0];
     Page *targetPage;
     bufMgr->readPage(file, targetPageId, targetPage);
-    PageId result;
+    T result;
     if (root->level == 1) {
-        LeafNodeInt *target = (LeafNodeInt *)targetPage;
+        LeafNode<T> *target = (LeafNode<T> *)targetPage;
         result = target->keyArray[0];
     } else {
-        NonLeafNodeInt *target = (NonLeafNodeInt *)targetPage;
+        NonLeafNode<T> *target = (NonLeafNode<T> *)targetPage;
         result = findSmallestKey(target);
     }
-    bufMgr->unPinPage(file, targetPageId, false);
+    bufMgr->unPinPage(targetPage, false);
     return result;
 }
 
 /**
- * Find the first leaf value in the subtree satisfying scan criteria
- * @param root Root of the tree
+ * Find the first leaf that may hold targetKey or the smallest key above it.
+ * A split can leave keys equal to the new separator on its left, so the descent
+ * takes the leftmost child that may hold targetKey; callers move right from there.
+ * Each node is latched shared before its parent is released.
+ * @param targetKey Smallest key satisfying scan criteria
+ * @param leafPage Returns the leaf, pinned and latched shared
  * @return PageId of first leaf
  */
-const PageId BTreeIndex::findFirstLeaf(NonLeafNodeInt *root) {
-    int targetKey = lowOp == GT ? lowValInt + 1 : lowValInt;
-    PageId targetPageId = 0;
-    int i = 0;
-    for (i = 0; i < nodeOccupancy && root->pageNoArray[i+1] != 0; ++i) {
-        if (root->keyArray[i] > targetKey) {
-            targetPageId = root->pageNoArray[i];
-            break;
-        }
+template <class T>
+const PageId BTreeIndex::findFirstLeaf(const T targetKey, Page *&leafPage) {
+    rootLatch.lockShared();
+    PageId pageNo = rootPageNum;
+    bool isLeaf = rootPageNum == 2;
+    Page *page;
+    bufMgr->readPage(file, pageNo, page);
+    bufMgr->latchPage(page, false);
+    rootLatch.unlock();
+    while (!isLeaf) {
+        typename NodeLayout<T>::NonLeaf *node = (typename NodeLayout<T>::NonLeaf *)page;
+        PageId nextPageNo = childPageNo(node, lowerBound(node, targetKey));
+        isLeaf = node->level == 1;
+        Page *childPage;
+        bufMgr->readPage(file, nextPageNo, childPage);
+        bufMgr->latchPage(childPage, false);
+        bufMgr->unPinPage(page, false);
+        bufMgr->unlatchPage(page);
+        pageNo = nextPageNo;
+        page = childPage;
     }
-    if (targetPageId == 0)
-        targetPageId = root->pageNoArray[i];
-    if (root->level == 1) {
-        return targetPageId;
-    } else {
-        Page *targetPage;
-        PageId result;
-        bufMgr->readPage(file, targetPageId, targetPage);
-        NonLeafNodeInt *target = (NonLeafNodeInt *)targetPage;
-        result = findFirstLeaf(target);
-        bufMgr->unPinPage(file, targetPageId, false);
-        return result;
+    leafPage = page;
+    return pageNo;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookup
+// -----------------------------------------------------------------------------
+
+const size_t BTreeIndex::lookup(const void* key, std::vector<RecordId>& out)
+{
+    if (attributeType == DOUBLE) {
+        return lookupKey(*(double *)key, &out);
+    }
+    if (attributeType == STRING) {
+        return lookupKey(readKey<std::string>(key), &out);
+    }
+    return lookupKey(*(int *)key, &out);
+}
+
+const bool BTreeIndex::contains(const void* key)
+{
+    if (attributeType == DOUBLE) {
+        return lookupKey(*(double *)key, nullptr) > 0;
+    }
+    if (attributeType == STRING) {
+        return lookupKey(readKey<std::string>(key), nullptr) > 0;
+    }
+    return lookupKey(*(int *)key, nullptr) > 0;
+}
+
+/**
+ * Find the entries whose key equals key. The leaf is reached the way a scan
+ * reaches its first leaf, and right siblings are followed while no key greater
+ * than key has been seen. The last leaf is released before returning.
+ * @param key Key to look up
+ * @param out Vector the record ids are appended to, or nullptr to stop at the first match
+ * @return Number of entries found
+ */
+template <class T>
+const size_t BTreeIndex::lookupKey(const T key, std::vector<RecordId> *out) {
+    Page *page;
+    findFirstLeaf(key, page);
+    size_t count = 0;
+    while (1) {
+        typename NodeLayout<T>::Leaf *leafNode = (typename NodeLayout<T>::Leaf *)page;
+        int begin = lowerBound(leafNode, key);
+        int end = upperBound(leafNode, key);
+        count += end - begin;
+        if (out == nullptr && count > 0)
+            break;
+        for (int i = begin; i < end && out != nullptr; ++i)
+            out->push_back(ridAt(leafNode, i));
+        PageId nextPageNo = leafNode->rightSibPageNo;
+        if (end < leafNode->numKeys || nextPageNo == 0)
+            break;
+        Page *nextPage;
+        bufMgr->readPage(file, nextPageNo, nextPage);
+        bufMgr->latchPage(nextPage, false);
+        bufMgr->unPinPage(page, false);
+        bufMgr->unlatchPage(page);
+        page = nextPage;
     }
+    bufMgr->unPinPage(page, false);
+    bufMgr->unlatchPage(page);
+    return count;
 }
 
 // -----------------------------------------------------------------------------
@@ -468,154 +1617,335 @@ const void BTreeIndex::startScan(const void* lowValParm,
 				   const void* highValParm,
 				   const Operator highOpParm)
 {
-    if (*(int *)lowValParm > *(int *)highValParm) {
+    scanCursor.startScan(lowValParm, lowOpParm, highValParm, highOpParm);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNext
+// -----------------------------------------------------------------------------
+
+const void BTreeIndex::scanNext(RecordId& outRid) 
+{
+    scanCursor.scanNext(outRid);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextBatch
+// -----------------------------------------------------------------------------
+
+const size_t BTreeIndex::scanNextBatch(RecordId* outRids, const size_t max)
+{
+    return scanCursor.scanNextBatch(outRids, max);
+}
+
+const size_t BTreeIndex::scanNextBatch(std::vector<RecordId>& outRids, const size_t max)
+{
+    return scanCursor.scanNextBatch(outRids, max);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::endScan
+// -----------------------------------------------------------------------------
+//
+const void BTreeIndex::endScan() 
+{
+    scanCursor.endScan();
+}
+
+// -----------------------------------------------------------------------------
+// ScanCursor::ScanCursor -- Constructor
+// -----------------------------------------------------------------------------
+
+ScanCursor::ScanCursor(BTreeIndex *index)
+{
+    this->index = index;
+    scanExecuting = false;
+    nextEntry = -1;
+    rangeScan = false;
+    currentPageNum = 0;
+    currentPageData = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+// ScanCursor::~ScanCursor -- destructor
+// -----------------------------------------------------------------------------
+
+ScanCursor::~ScanCursor()
+{
+    if (scanExecuting) {
+        endScan();
+    }
+}
+
+/**
+ * Bounds of the scan for the key type of the index.
+ */
+template <>
+int &ScanCursor::lowVal<int>() { return lowValInt; }
+
+template <>
+int &ScanCursor::highVal<int>() { return highValInt; }
+
+template <>
+double &ScanCursor::lowVal<double>() { return lowValDouble; }
+
+template <>
+double &ScanCursor::highVal<double>() { return highValDouble; }
+
+template <>
+std::string &ScanCursor::lowVal<std::string>() { return lowValString; }
+
+template <>
+std::string &ScanCursor::highVal<std::string>() { return highValString; }
+
+/**
+ * Ask the buffer manager to read the right sibling of the current leaf in the
+ * background, so the scan does not wait for it when it gets there.
+ */
+template <class T>
+const void ScanCursor::prefetchRightSibling() {
+    PageId nextPageNum = ((typename NodeLayout<T>::Leaf *)currentPageData)->rightSibPageNo;
+    if (nextPageNum != 0)
+        index->bufMgr->prefetchPage(index->file, nextPageNum);
+}
+
+/**
+ * Move the scan to the right sibling of the current leaf. The sibling is
+ * latched before the current leaf is released.
+ * @return False if the current leaf is the last one, which is then kept
+ */
+template <class T>
+const bool ScanCursor::moveToRightSibling() {
+    PageId nextPageNum = ((typename NodeLayout<T>::Leaf *)currentPageData)->rightSibPageNo;
+    if (nextPageNum == 0)
+        return false;
+    Page *nextPageData;
+    index->bufMgr->readPage(index->file, nextPageNum, nextPageData);
+    index->bufMgr->latchPage(nextPageData, false);
+    index->bufMgr->unPinPage(currentPageData, false);
+    index->bufMgr->unlatchPage(currentPageData);
+    currentPageNum = nextPageNum;
+    currentPageData = nextPageData;
+    prefetchRightSibling<T>();
+    if (!rangeScan) {
+        rangeScan = true;
+        index->adviseRangeScan(true);
+    }
+    return true;
+}
+
+/**
+ * Whether key i of a leaf is past the high end of the scan.
+ */
+template <class T>
+const bool ScanCursor::exceedsHigh(const typename NodeLayout<T>::Leaf *node, const int i) {
+    int c = compareKey(node, i, highVal<T>());
+    return highOp == LT ? c >= 0 : c > 0;
+}
+
+// -----------------------------------------------------------------------------
+// ScanCursor::startScan
+// -----------------------------------------------------------------------------
+
+const void ScanCursor::startScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+    if (index->attributeType == DOUBLE) {
+        startScanTyped(*(double *)lowValParm, lowOpParm, *(double *)highValParm, highOpParm);
+    } else if (index->attributeType == STRING) {
+        startScanTyped(readKey<std::string>(lowValParm), lowOpParm, readKey<std::string>(highValParm), highOpParm);
+    } else {
+        startScanTyped(*(int *)lowValParm, lowOpParm, *(int *)highValParm, highOpParm);
+    }
+}
+
+template <class T>
+const void ScanCursor::startScanTyped(const T lowValParm,
+				   const Operator lowOpParm,
+				   const T highValParm,
+				   const Operator highOpParm)
+{
+    if (lowValParm > highValParm) {
         throw BadScanrangeException();
     }
     if (!(lowOpParm == GT || lowOpParm == GTE) ||
         !(highOpParm == LT || highOpParm == LTE)) {
         throw BadOpcodesException();
     }
-    lowValInt = *(int *)lowValParm;
-    highValInt = *(int *)highValParm;
+    if (scanExecuting) {
+        endScan();
+    }
+    lowVal<T>() = lowValParm;
+    highVal<T>() = highValParm;
     lowOp = lowOpParm;
     highOp = highOpParm;
     scanExecuting = true;
-    if (rootPageNum < 2)
-        return;
-    if (rootPageNum == 2) {  // TODO: doable?
-        currentPageNum = 2;
-    } else {
-        Page *rootPage;
-        bufMgr->readPage(file, rootPageNum, rootPage);
-        currentPageNum = findFirstLeaf((NonLeafNodeInt *)rootPage);
-        bufMgr->unPinPage(file, rootPageNum, false);
-    }
-    bufMgr->readPage(file, currentPageNum, currentPageData);
+    // the first leaf that may hold lowVal, for GT as well as GTE; the loop moves right if it has no match
+    currentPageNum = index->findFirstLeaf(lowValParm, currentPageData);
     while (1) {
         // read through entries in current page
         // if find first entry, get it
-        int i = 0;
-        bool getFirst = false;
+        typename NodeLayout<T>::Leaf *leafNode = (typename NodeLayout<T>::Leaf *) currentPageData;
+        int count = leafNode->numKeys;
+        int i = lowOpParm == GT ? upperBound(leafNode, lowValParm)
+                                : lowerBound(leafNode, lowValParm);
+        bool getFirst = i < count;
         bool alreadyExceed = false;
-        LeafNodeInt *leafNodeInt = (LeafNodeInt *) currentPageData;
-        for (; i < leafOccupancy && leafNodeInt->ridArray[i].page_number != 0; ++i) {
-            if (highOpParm == LT) {
-                if (leafNodeInt->keyArray[i] >= highValInt) {
-                    alreadyExceed = true;
-                    break;
-                }
-            } else {
-                if (leafNodeInt->keyArray[i] > highValInt) {
-                    alreadyExceed = true;
-                    break;
-                }
-            }
-            if (lowOpParm == GT) {
-                if (leafNodeInt->keyArray[i] > lowValInt) {
-                    nextEntry = i;
-                    getFirst = true;
-                    break;
-                }
-            } else {
-                if (leafNodeInt->keyArray[i] >= lowValInt) {
-                    nextEntry = i;
-                    getFirst = true;
-                    break;
-                }
-            }
-        }
-        if (alreadyExceed) {
-            bufMgr->unPinPage(file, currentPageNum, false);
-            throw NoSuchKeyFoundException();
-        }
         if (getFirst) {
+            nextEntry = i;
+            alreadyExceed = exceedsHigh<T>(leafNode, i);
+        }
+        if (getFirst && !alreadyExceed) {
+            prefetchRightSibling<T>();
             break;
-        } else {    // not get the entry
-            PageId nextPageNum = leafNodeInt->rightSibPageNo;
-            bufMgr->unPinPage(file, currentPageNum, false);
-            if (nextPageNum == 0) {
-                // no next page, not found such key
-                throw NoSuchKeyFoundException();
-            }
-            currentPageNum = nextPageNum;
-            bufMgr->readPage(file, currentPageNum, currentPageData);
+        }
+        // not get the entry: try next page unless keys already exceed the range
+        if (alreadyExceed || !moveToRightSibling<T>()) {
+            // no next page, not found such key
+            index->bufMgr->unPinPage(currentPageData, false);
+            index->bufMgr->unlatchPage(currentPageData);
+            currentPageData = nullptr;
+            nextEntry = -1;
+            throw NoSuchKeyFoundException();
         }
     }
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::scanNext
+// ScanCursor::scanNext
 // -----------------------------------------------------------------------------
 
-const void BTreeIndex::scanNext(RecordId& outRid) 
+const void ScanCursor::scanNext(RecordId& outRid) 
 {
     if (scanExecuting == false) {
         throw ScanNotInitializedException();
     }
+    if (index->attributeType == DOUBLE) {
+        scanNextTyped<double>(outRid);
+    } else if (index->attributeType == STRING) {
+        scanNextTyped<std::string>(outRid);
+    } else {
+        scanNextTyped<int>(outRid);
+    }
+}
+
+template <class T>
+const void ScanCursor::scanNextTyped(RecordId& outRid)
+{
     // read currentPageData, getNextEntry if valid
     // continue to next page if valid else break
-    if (nextEntry < 0 || nextEntry >= leafOccupancy) {
+    if (nextEntry < 0 || nextEntry >= index->leafOccupancy) {
         throw IndexScanCompletedException();
     }
-    LeafNodeInt *leafNodeInt = (LeafNodeInt *)currentPageData;
-    outRid = leafNodeInt->ridArray[nextEntry];
+    typename NodeLayout<T>::Leaf *leafNode = (typename NodeLayout<T>::Leaf *)currentPageData;
+    outRid = ridAt(leafNode, nextEntry);
     // still within one leaf and it has data
-    if (nextEntry + 1 < leafOccupancy &&
-        leafNodeInt->ridArray[nextEntry + 1].page_number != 0) {
-        if (highOp == LT) {
-            if (leafNodeInt->keyArray[nextEntry + 1] < highValInt) {
-                nextEntry++;
-            } else {
-                nextEntry = -1;
-            }
+    if (nextEntry + 1 < leafNode->numKeys) {
+        if (!exceedsHigh<T>(leafNode, nextEntry + 1)) {
+            nextEntry++;
         } else {
-            if (leafNodeInt->keyArray[nextEntry + 1] <= highValInt) {
-                nextEntry++;
-            } else {
-                nextEntry = -1;
-            }
+            nextEntry = -1;
         }
     } else {    // go to next page or report finish
-        if (leafNodeInt->rightSibPageNo == 0) {
+        if (!moveToRightSibling<T>()) {
             nextEntry = -1;
         } else {
-            PageId nextPageNum = leafNodeInt->rightSibPageNo;
-            bufMgr->unPinPage(file, currentPageNum, false);
-            currentPageNum = nextPageNum;
-            bufMgr->readPage(file, currentPageNum, currentPageData);
-            LeafNodeInt *leafNodeInt = (LeafNodeInt *)currentPageData;
-            nextEntry = 0;
+            leafNode = (typename NodeLayout<T>::Leaf *)currentPageData;
             // need to check first entry in next leaf is valid or not
-            if (highOp == LT) {
-                if (leafNodeInt->keyArray[nextEntry] >= highValInt) {
-                    nextEntry = -1;
-                }
+            if (leafNode->numKeys == 0 || exceedsHigh<T>(leafNode, 0)) {
+                nextEntry = -1;
             } else {
-                if (leafNodeInt->keyArray[nextEntry] > highValInt) {
-                    nextEntry = -1;
-                }
+                nextEntry = 0;
             }
         }
     }
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::endScan
+// ScanCursor::scanNextBatch
 // -----------------------------------------------------------------------------
-//
-const void BTreeIndex::endScan() 
+
+const size_t ScanCursor::scanNextBatch(RecordId* outRids, const size_t max)
 {
     if (scanExecuting == false) {
         throw ScanNotInitializedException();
     }
-    try {
-        scanExecuting = false;
-        bufMgr->unPinPage(file, currentPageNum, false);
-    } catch (PageNotPinnedException e) {
+    if (index->attributeType == DOUBLE) {
+        return scanNextBatchTyped<double>(outRids, max);
+    }
+    if (index->attributeType == STRING) {
+        return scanNextBatchTyped<std::string>(outRids, max);
+    }
+    return scanNextBatchTyped<int>(outRids, max);
+}
 
-    } catch (HashNotFoundException e) {
+template <class T>
+const size_t ScanCursor::scanNextBatchTyped(RecordId* outRids, const size_t max)
+{
+    size_t count = 0;
+    while (count < max && nextEntry >= 0) {
+        typename NodeLayout<T>::Leaf *leafNode = (typename NodeLayout<T>::Leaf *)currentPageData;
+        // entries [nextEntry, end) of this leaf are all in range
+        int end = highOp == LT ? lowerBound(leafNode, highVal<T>())
+                               : upperBound(leafNode, highVal<T>());
+        size_t run = std::min((size_t)(end - nextEntry), max - count);
+        copyRids(leafNode, nextEntry, run, outRids + count);
+        count += run;
+        nextEntry += run;
+        if (nextEntry < end) {
+            break;
+        }
+        // the range ends in this leaf, or there is no next page
+        if (end < leafNode->numKeys || !moveToRightSibling<T>()) {
+            nextEntry = -1;
+            break;
+        }
+        leafNode = (typename NodeLayout<T>::Leaf *)currentPageData;
+        if (leafNode->numKeys == 0 || exceedsHigh<T>(leafNode, 0)) {
+            nextEntry = -1;
+        } else {
+            nextEntry = 0;
+        }
+    }
+    return count;
+}
 
+const size_t ScanCursor::scanNextBatch(std::vector<RecordId>& outRids, const size_t max)
+{
+    if (scanExecuting == false) {
+        throw ScanNotInitializedException();
     }
+    size_t oldSize = outRids.size();
+    outRids.resize(oldSize + max);
+    size_t count = scanNextBatch(outRids.data() + oldSize, max);
+    outRids.resize(oldSize + count);
+    return count;
+}
+
+// -----------------------------------------------------------------------------
+// ScanCursor::endScan
+// -----------------------------------------------------------------------------
+//
+const void ScanCursor::endScan() 
+{
+    if (scanExecuting == false) {
+        throw ScanNotInitializedException();
+    }
+    scanExecuting = false;
+    nextEntry = -1;
+    if (rangeScan) {
+        rangeScan = false;
+        index->adviseRangeScan(false);
+    }
+    if (currentPageData == nullptr) {
+        return;
+    }
+    Page *page = currentPageData;
+    currentPageData = nullptr;
+    index->bufMgr->tryUnPinPage(page, false);
+    index->bufMgr->unlatchPage(page);
 
 }
 
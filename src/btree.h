@@ -11,11 +11,14 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <vector>
+#include <mutex>
 
 #include "types.h"
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "string_node.h"
 
 namespace badgerdb
 {
@@ -45,17 +48,60 @@ enum Operator
 /**
  * @brief Number of key slots in B+Tree leaf for INTEGER key.
  */
-//                                                  sibling ptr             key               rid
-const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+//                                                  sibling ptr        numKeys               key               rid
+const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) - sizeof( int ) ) / ( sizeof( int ) + sizeof( RecordId ) );
 //const  int INTARRAYLEAFSIZE = 9;
 
 /**
  * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
  */
-//                                                     level     extra pageNo                  key       pageNo
+//                                               level + numKeys     extra pageNo                  key       pageNo
 const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
 //const  int INTARRAYNONLEAFSIZE = 9;
 
+/**
+ * @brief Number of key slots in B+Tree leaf for DOUBLE key.
+ */
+//                                                    sibling ptr        numKeys                key                  rid
+const  int DOUBLEARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) - sizeof( int ) ) / ( sizeof( double ) + sizeof( RecordId ) );
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for DOUBLE key.
+ */
+//                                         level + numKeys, padded to a double   extra pageNo                key          pageNo
+const  int DOUBLEARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( double ) - sizeof( PageId ) ) / ( sizeof( double ) + sizeof( PageId ) );
+
+/**
+ * @brief Number of key slots in the nodes of a tree whose keys are of type T.
+ */
+template <class T>
+struct NodeFanout;
+
+template <>
+struct NodeFanout<int> {
+	static const int LEAF = INTARRAYLEAFSIZE;
+	static const int NONLEAF = INTARRAYNONLEAFSIZE;
+};
+
+template <>
+struct NodeFanout<double> {
+	static const int LEAF = DOUBLEARRAYLEAFSIZE;
+	static const int NONLEAF = DOUBLEARRAYNONLEAFSIZE;
+};
+
+/**
+ * @brief Default fraction of each node's key slots filled when an index is bulk loaded.
+ * Leaving some slack lets later inserts land without splitting right away.
+ */
+const double BULKLOAD_FILL_FACTOR = 0.9;
+
+/**
+ * @brief On-disk format version of the index file, stored in IndexMetaInfo.
+ * Version 1 nodes had no key count and marked empty slots with zero page numbers.
+ * Version 2 nodes store their key count explicitly.
+ */
+const int INDEX_FORMAT_VERSION = 2;
+
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
  * add to or make changes to the leaf node pages of the tree. Is templated for the key member.
@@ -102,6 +148,21 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
 		return r1.rid.page_number < r2.rid.page_number;
 }
 
+/**
+ * @brief A node pinned and latched by a thread descending the tree.
+*/
+struct LatchedNode{
+  /**
+   * Page number of the node.
+   */
+	PageId pageNo;
+
+  /**
+   * The pinned page holding the node.
+   */
+	Page *page;
+};
+
 /**
  * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
  * to the following structure to store or retrieve information from it.
@@ -109,6 +170,8 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
  * of the key value on which the index is made, the type of the key and the page no
  * of the root page. Root page starts as page 2 but since a split can occur
  * at the root the root page may get moved up and get a new page no.
+ * Page 2 always stays the leftmost leaf, since splits and merges keep the left
+ * node, so the root is a leaf exactly when its page no is 2.
 */
 struct IndexMetaInfo{
   /**
@@ -130,6 +193,11 @@ struct IndexMetaInfo{
    * Page number of root page of the B+ Tree inside the file index file.
    */
 	PageId rootPageNo;
+
+  /**
+   * On-disk format version of the nodes. Files written before the field existed read 0 here.
+   */
+	int version;
 };
 
 /*
@@ -137,104 +205,122 @@ Each node is a page, so once we read the page in we just cast the pointer to the
 These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
 node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
 at this level are just above the leaf nodes. Otherwise set to 0.
+Every node stores the number of keys in use; used entries are always packed at the front of the arrays.
 */
 
 /**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+ * @brief Structure for all non-leaf nodes, templated for the key type.
 */
-struct NonLeafNodeInt{
+template <class T>
+struct NonLeafNode{
   /**
    * Level of the node in the tree.
    */
-	int level;
+	std::uint16_t level;
+
+  /**
+   * Number of keys in use. The node has numKeys + 1 children.
+   */
+	std::uint16_t numKeys;
 
   /**
    * Stores keys.
    */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	T keyArray[ NodeFanout<T>::NONLEAF ];
 
   /**
    * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
    */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
+	PageId pageNoArray[ NodeFanout<T>::NONLEAF + 1 ];
 };
 
 
 /**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
+ * @brief Structure for all leaf nodes, templated for the key type.
 */
-struct LeafNodeInt{
+template <class T>
+struct LeafNode{
   /**
    * Stores keys.
    */
-	int keyArray[ INTARRAYLEAFSIZE ];
+	T keyArray[ NodeFanout<T>::LEAF ];
 
   /**
    * Stores RecordIds.
    */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
+	RecordId ridArray[ NodeFanout<T>::LEAF ];
 
   /**
    * Page number of the leaf on the right side.
 	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
    */
 	PageId rightSibPageNo;
+
+  /**
+   * Number of keys in use.
+   */
+	int numKeys;
 };
 
+/**
+ * @brief Node layouts when the key is of INTEGER type.
+*/
+typedef NonLeafNode<int> NonLeafNodeInt;
+typedef LeafNode<int> LeafNodeInt;
 
 /**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
+ * @brief Node layouts when the key is of DOUBLE type.
 */
-class BTreeIndex {
+typedef NonLeafNode<double> NonLeafNodeDouble;
+typedef LeafNode<double> LeafNodeDouble;
 
- private:
+/**
+ * @brief Node layouts of a tree whose keys are of type T.
+*/
+template <class T>
+struct NodeLayout {
+	typedef LeafNode<T> Leaf;
+	typedef NonLeafNode<T> NonLeaf;
+};
 
-  /**
-   * File object for the index file.
-   */
-	File		*file;
+/**
+ * @brief STRING keys vary in length, so their nodes are slotted pages; see string_node.h.
+*/
+template <>
+struct NodeLayout<std::string> {
+	typedef StringLeafNode Leaf;
+	typedef StringNonLeafNode NonLeaf;
+};
 
-  /**
-   * Buffer Manager Instance.
-   */
-	BufMgr	*bufMgr;
+static_assert(sizeof(NonLeafNodeInt) <= Page::SIZE && sizeof(LeafNodeInt) <= Page::SIZE,
+              "INTEGER nodes must fit in a page");
+static_assert(sizeof(NonLeafNodeDouble) <= Page::SIZE && sizeof(LeafNodeDouble) <= Page::SIZE,
+              "DOUBLE nodes must fit in a page");
+static_assert(sizeof(StringNonLeafNode) <= Page::SIZE && sizeof(StringLeafNode) <= Page::SIZE,
+              "STRING nodes must fit in a page");
 
-  /**
-   * Page number of meta page.
-   */
-	PageId	headerPageNum;
-
-  /**
-   * page number of root page of B+ tree inside index file.
-   */
-	PageId	rootPageNum;
 
-  /**
-   * Datatype of attribute over which index is built.
-   */
-	Datatype	attributeType;
+class BTreeIndex;
 
-  /**
-   * Offset of attribute, over which index is built, inside records. 
-   */
-	int 		attrByteOffset;
+/**
+ * @brief ScanCursor class. It runs one filtered scan over a BTreeIndex and owns all of
+ * the scan state: the range, the leaf it is positioned on and the next entry in it.
+ * Any number of cursors may be open on the same index at once, from one thread or
+ * from several. The current leaf stays pinned and latched shared while the cursor is
+ * positioned on it, so a cursor must be ended before its thread inserts into the index,
+ * and every cursor must be ended or destroyed before the index is.
+*/
+class ScanCursor {
 
-  /**
-   * Number of keys in leaf node, depending upon the type of key.
-   */
-	int			leafOccupancy;
+ private:
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Index being scanned.
    */
-	int			nodeOccupancy;
-
-
-	// MEMBERS SPECIFIC TO SCANNING
+	BTreeIndex	*index;
 
   /**
-   * True if an index scan has been started.
+   * True if a scan has been started.
    */
 	bool		scanExecuting;
 
@@ -243,13 +329,18 @@ class BTreeIndex {
    */
 	int			nextEntry;
 
+  /**
+   * True once the scan has moved past its first leaf, so that it counts as a range scan of the index.
+   */
+	bool		rangeScan;
+
   /**
    * Page number of current page being scanned.
    */
 	PageId	currentPageNum;
 
   /**
-   * Current Page being scanned.
+   * Current Page being scanned. Kept pinned and latched shared until the scan moves on.
    */
 	Page		*currentPageData;
 
@@ -293,40 +384,292 @@ class BTreeIndex {
    */
 	Operator	highOp;
 
-	const void insertEntryHelper(bool isLeaf, const PageId rootPageID, PageKeyPair<int> &newChildEntry,
-                                 RIDKeyPair<int> entryPair);
+	template <class T>
+	T &lowVal();
+
+	template <class T>
+	T &highVal();
+
+	template <class T>
+	const bool exceedsHigh(const typename NodeLayout<T>::Leaf *node, const int i);
+
+	template <class T>
+	const void prefetchRightSibling();
+
+	template <class T>
+	const bool moveToRightSibling();
+
+	template <class T>
+	const void startScanTyped(const T lowVal, const Operator lowOp, const T highVal, const Operator highOp);
+
+	template <class T>
+	const void scanNextTyped(RecordId& outRid);
+
+	template <class T>
+	const size_t scanNextBatchTyped(RecordId* outRids, const size_t max);
+
+	friend class BTreeIndex;
+
+ public:
+
+  /**
+   * ScanCursor Constructor. The cursor starts out with no scan.
+   *
+   * @param index		Index to scan
+   */
+	ScanCursor(BTreeIndex *index);
+
+  /**
+   * ScanCursor Destructor. Ends the scan if one is executing.
+   */
+	~ScanCursor();
+
+  /**
+	 * Begin a filtered scan of the index. If this cursor is already executing a scan, it is ended first.
+	 * Start from root to find out the leaf page that contains the first RecordID
+	 * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+	**/
+	const void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+  /**
+	 * Fetch the record id of the next index entry that matches the scan.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	const void scanNext(RecordId& outRid);
+
+  /**
+	 * Fetch the record ids of up to max following index entries that match the scan.
+	 * Runs of qualifying entries are copied out of each leaf in one go.
+   * @param outRids	Array of at least max record ids the results are written to
+   * @param max	Largest number of record ids to return
+   * @return	Number of record ids returned; less than max only once the scan is completed
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	const size_t scanNextBatch(RecordId* outRids, const size_t max);
+
+  /**
+	 * Append the record ids of up to max following index entries that match the scan.
+   * @param outRids	Vector the results are appended to
+   * @param max	Largest number of record ids to append
+   * @return	Number of record ids appended; less than max only once the scan is completed
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	const size_t scanNextBatch(std::vector<RecordId>& outRids, const size_t max);
+
+  /**
+	 * Terminate the scan. Unpin any pinned pages. Reset scan specific variables.
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	const void endScan();
+};
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
+ * relation. The scan methods of the index drive a single built-in cursor; use
+ * ScanCursor objects to run several scans at a time.
+ *
+ * Inserts and deletes may run concurrently with each other and with scans. Nodes are latched
+ * through the buffer manager: readers couple shared latches from the root down and
+ * along the leaves, and writers hold exclusive latches only on the part of the path
+ * that a split or merge could still reach. Siblings are latched left to right, and
+ * pages are unpinned before they are unlatched, so a page latched exclusive below an
+ * exclusive parent is pinned by nobody else and may be disposed of. A thread with an
+ * open scan must not modify the index, as the scan keeps its current leaf latched.
+*/
+class BTreeIndex {
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * page number of root page of B+ tree inside index file.
+   */
+	PageId	rootPageNum;
+
+  /**
+   * Latch guarding rootPageNum. Held exclusive by a writer while the root may split or collapse.
+   */
+	RWLatch	rootLatch;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records. 
+   */
+	int 		attrByteOffset;
 
-    const void placeEntry(RIDKeyPair<int> entryPair, LeafNodeInt *node);
+  /**
+   * Number of keys in leaf node, depending upon the type of key.
+   * STRING nodes fit as many keys as their bytes allow; this is their number of slots.
+   */
+	int			leafOccupancy;
 
-    const void splitLeaf(LeafNodeInt *leftLeafNode, PageKeyPair<int> &newChildEntry, RIDKeyPair<int> entryPair,
+  /**
+   * Number of keys in non-leaf node, depending upon the type of key.
+   */
+	int			nodeOccupancy;
+
+
+	// MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * Cursor driven by startScan(), scanNext() and endScan() of the index itself.
+   */
+	ScanCursor	scanCursor;
+
+  /**
+   * Number of cursors in a range scan. While there are any the index file is read sequentially,
+   * otherwise it is probed at random.
+   */
+	int			rangeScans;
+
+  /**
+   * Mutex guarding rangeScans and the access hint that follows from it.
+   */
+	std::mutex	accessHintMutex;
+
+  /**
+   * Fraction of key slots filled in each node when the index is bulk loaded.
+   */
+	double		fillFactor;
+
+	template <class T>
+	const void bulkLoadRelation(const std::string &relationName);
+
+	template <class T>
+	const void bulkLoad(std::vector<RIDKeyPair<T> > &entries);
+
+	template <class T>
+	const void bulkLoadLeaves(const std::vector<RIDKeyPair<T> > &entries,
+                              std::vector<PageKeyPair<T> > &parentEntries);
+
+	template <class T>
+	const void bulkLoadNonLeaves(const std::vector<PageKeyPair<T> > &childEntries, const int level,
+                                 std::vector<PageKeyPair<T> > &parentEntries);
+
+	template <class T>
+	const void insertKey(const T key, const RecordId rid);
+
+	template <class T>
+	const bool deleteKey(const T key, const RecordId rid);
+
+	template <class T>
+	const bool nextLeaf(std::vector<LatchedNode> &path, std::vector<int> &childIndexes, const T key);
+
+	const void releaseNodes(std::vector<LatchedNode> &path, const bool dirty);
+
+    template <class T>
+    const void placeEntry(RIDKeyPair<T> entryPair, LeafNode<T> *node);
+
+    template <class T>
+    const void splitLeaf(LeafNode<T> *leftLeafNode, PageKeyPair<T> &newChildEntry, RIDKeyPair<T> entryPair,
                          PageId leftPageId);
 
-    const void placeNewChild(PageKeyPair<int> &newChildEntry, NonLeafNodeInt *node);
+    template <class T>
+    const void placeNewChild(PageKeyPair<T> &newChildEntry, NonLeafNode<T> *node, const int childIndex);
 
-    const void splitNonLeaf(NonLeafNodeInt *leftNonLeafNode, PageId leftPageId, PageKeyPair<int> &newChildEntry);
+    template <class T>
+    const void splitNonLeaf(NonLeafNode<T> *leftNonLeafNode, PageId leftPageId, PageKeyPair<T> &newChildEntry,
+                            const int childIndex);
 
     const void changeRootPageNum(const PageId newRootPageNum);
 
-    const int findSmallestKey(NonLeafNodeInt *root);
+  /**
+   * Count a range scan starting or ending, and tell the file how it is being read when the
+   * first one starts or the last one ends.
+   * @param starting	True if a range scan is starting
+   */
+    const void adviseRangeScan(const bool starting);
+
+    template <class T>
+    const T findSmallestKey(NonLeafNode<T> *root);
+
+    const void upgradeIndexFile();
+
+    const void upgradeNode(const PageId pageNo, const bool isLeaf);
+
+    const void insertStringLeaf(LatchedNode &leaf, const std::string &key, const RecordId rid,
+                                PageKeyPair<std::string> &newChildEntry);
+
+    const void insertStringNonLeaf(LatchedNode &node, PageKeyPair<std::string> &newChildEntry,
+                                   const int childIndex);
 
-    const PageId findFirstLeaf(NonLeafNodeInt *root);
+    const void growStringRoot(const PageId leftPageNo, PageKeyPair<std::string> &newChildEntry, const int level);
+
+    const bool rebalanceStringChild(StringNonLeafNode *parent, const int childIndex, LatchedNode &child,
+                                    const bool isLeaf);
+
+    template <class T>
+    const size_t lookupKey(const T key, std::vector<RecordId> *out);
+
+    template <class T>
+    const PageId findFirstLeaf(const T targetKey, Page *&leafPage);
+
+    template <class T>
+    const bool rebalanceChild(NonLeafNode<T> *parent, const int childIndex, LatchedNode &child, const bool isLeaf);
+
+    template <class T>
+    const void removeChild(NonLeafNode<T> *node, const int keyIndex);
+
+    template <class T>
+    const void mergeLeaves(LeafNode<T> *left, LeafNode<T> *right);
+
+    template <class T>
+    const T redistributeLeaves(LeafNode<T> *left, LeafNode<T> *right);
+
+    template <class T>
+    const void mergeNonLeaves(NonLeafNode<T> *left, NonLeafNode<T> *right, const T separator);
+
+    template <class T>
+    const T redistributeNonLeaves(NonLeafNode<T> *left, NonLeafNode<T> *right, const T separator);
+
+	friend class ScanCursor;
 
 public:
 
   /**
    * BTreeIndex Constructor. 
 	 * Check to see if the corresponding index file exists. If so, open the file.
-	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+	 * If not, create it and bulk load it with entries for every tuple in the base relation using FileScan class.
+	 * The entries are sorted and packed into leaves and non-leaf levels bottom-up, left to right.
    *
    * @param relationName        Name of file.
    * @param outIndexName        Return the name of index file.
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
+   * @param fillFactor					Fraction of each node filled when a new index is bulk loaded, in (0, 1]
    * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const double fillFactor = BULKLOAD_FILL_FACTOR);
 	
 
   /**
@@ -344,17 +687,55 @@ public:
 	 * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
 	 * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
 	 * Make sure to unpin pages as soon as you can.
+	 * Nodes are latched exclusive on the way down; once a node has room for one more entry,
+	 * no split can travel above it, so the latches and pins of its ancestors are released.
    * @param key			Key to insert, pointer to integer/double/char string
    * @param rid			Record ID of a record whose entry is getting inserted into the index.
 	**/
 	const void insertEntry(const void* key, const RecordId rid);
 
 
+  /**
+	 * Delete the entry with the pair <value,rid>.
+	 * The leaf is found the same way as for insertion. A node left with fewer than half of its
+	 * entries borrows entries from a sibling, or is merged with it when both fit in one node,
+	 * which takes an entry out of the parent and may in turn leave it short. A root left with a single
+	 * child is replaced by that child, and pages emptied by merges are handed back to the index file to be reused.
+	 * Nodes are latched exclusive on the way down; once a node has more than the minimum number of entries,
+	 * no merge can travel above it, so the latches and pins of its ancestors are released.
+	 * A scan holding a leaf keeps deletions out of it until the scan moves on.
+   * @param key			Key to delete, pointer to integer/double/char string
+   * @param rid			Record ID of the record whose entry is getting deleted from the index.
+   * @return	False if there is no such entry in the index.
+	**/
+	const bool deleteEntry(const void* key, const RecordId rid);
+
+
+  /**
+	 * Append the record ids of all entries whose key equals key.
+	 * Unlike a scan, a lookup leaves no state behind and no pages pinned once it returns,
+	 * so it does not disturb the scan of the index, and a missing key is not an error.
+   * @param key	Key to look up, pointer to integer / double / char string
+   * @param out	Vector the record ids are appended to
+   * @return	Number of record ids appended; zero if the key is not in the index
+	**/
+	const size_t lookup(const void* key, std::vector<RecordId>& out);
+
+
+  /**
+	 * Check whether any entry has the given key, stopping at the first one found.
+   * @param key	Key to look up, pointer to integer / double / char string
+   * @return	True if the key is in the index
+	**/
+	const bool contains(const void* key);
+
+
   /**
 	 * Begin a filtered scan of the index.  For instance, if the method is called 
 	 * using ("a",GT,"d",LTE) then we should seek all entries with a value 
 	 * greater than "a" and less than or equal to "d".
 	 * If another scan is already executing, that needs to be ended here.
+	 * This runs on the index's own cursor; see ScanCursor for independent scans.
 	 * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
 	 * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
    * @param lowVal	Low value of range, pointer to integer / double / char string
@@ -378,6 +759,26 @@ public:
 	const void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+	 * Fetch the record ids of up to max following index entries that match the scan.
+	 * Unlike scanNext, running out of entries is reported through the return value.
+   * @param outRids	Array of at least max record ids the results are written to
+   * @param max	Largest number of record ids to return
+   * @return	Number of record ids returned; less than max only once the scan is completed
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	const size_t scanNextBatch(RecordId* outRids, const size_t max);
+
+  /**
+	 * Append the record ids of up to max following index entries that match the scan.
+   * @param outRids	Vector the results are appended to
+   * @param max	Largest number of record ids to append
+   * @return	Number of record ids appended; less than max only once the scan is completed
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	const size_t scanNextBatch(std::vector<RecordId>& outRids, const size_t max);
+
+
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
@@ -15,100 +15,103 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+std::uint32_t BufHashTbl::hash(const File* file, const PageId pageNo) const
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  // 64-bit finalizer from MurmurHash3, so neighbouring pages of one file and
+  // the same page of neighbouring files spread over the whole table
+  std::uint64_t key = ((std::uint64_t) file->id() << 32) | pageNo;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return (std::uint32_t) key & (HTSIZE - 1);
+}
+
+std::uint32_t BufHashTbl::probe(const File* file, const PageId pageNo) const
+{
+  std::uint32_t index = hash(file, pageNo);
+  // the table is never more than half full, so this always reaches an empty bucket
+  while (ht[index].file != NULL
+         && !(ht[index].file == file && ht[index].pageNo == pageNo))
+    index = (index + 1) & (HTSIZE - 1);
+  return index;
 }
 
 BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+	: HTSIZE(2), maxEntries(htSize), numEntries(0)
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
-  for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+  while (HTSIZE < 2 * maxEntries)
+    HTSIZE <<= 1;
+
+  // allocate every bucket up front
+  ht = new hashBucket [HTSIZE];
+  for(std::uint32_t i=0; i < HTSIZE; i++)
+    ht[i].file = NULL;
 }
 
 BufHashTbl::~BufHashTbl()
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
-    }
-  }
   delete [] ht;
 }
 
 void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
-
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
-  }
+  std::uint32_t index = probe(file, pageNo);
+  if (ht[index].file != NULL)
+    throw HashAlreadyPresentException(ht[index].file->filename(), ht[index].pageNo, ht[index].frameNo);
 
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
+  if (numEntries >= maxEntries)
   	throw HashTableException();
 
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  ht[index].file = (File*) file;
+  ht[index].pageNo = pageNo;
+  ht[index].frameNo = frameNo;
+  numEntries++;
 }
 
 void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-    {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
-    }
-    tmpBuc = tmpBuc->next;
-  }
+  if (!tryLookup(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
 
-  throw HashNotFoundException(file->filename(), pageNo);
+bool BufHashTbl::tryLookup(const File* file, const PageId pageNo, FrameId &frameNo)
+{
+  std::uint32_t index = probe(file, pageNo);
+  if (ht[index].file == NULL)
+    return false;
+
+  frameNo = ht[index].frameNo; // return frameNo by reference
+  return true;
 }
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
+  std::uint32_t hole = probe(file, pageNo);
+  if (ht[hole].file == NULL)
+    throw HashNotFoundException(file->filename(), pageNo);
 
-  while (tmpBuc)
+  // shift later entries of the probe run back into the hole, so lookups
+  // never need to skip over deleted buckets
+  std::uint32_t index = hole;
+  while (true)
 	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
+    index = (index + 1) & (HTSIZE - 1);
+    if (ht[index].file == NULL)
+      break;
 
-      delete tmpBuc;
-      return;
-    }
-		else
+    std::uint32_t home = hash(ht[index].file, ht[index].pageNo);
+    // move the entry unless its home bucket lies cyclically in (hole, index]
+    if (((index - home) & (HTSIZE - 1)) >= ((index - hole) & (HTSIZE - 1)))
 		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
+      ht[hole] = ht[index];
+      hole = index;
     }
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  ht[hole].file = NULL;
+  numEntries--;
 }
 
 }
@@ -16,7 +16,7 @@ namespace badgerdb {
 */
 struct hashBucket {
 	/**
-	 * pointer a file object (more on this below)
+	 * pointer a file object (more on this below), NULL if the slot is empty
 	 */
 	File *file;
 
@@ -29,43 +29,64 @@ struct hashBucket {
 	 * frame number of page in the buffer pool
 	 */
 	FrameId frameNo;
-
-	/**
-	 * Next node in the hash table
-	 */
-	hashBucket*   next;
 };
 
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
+* Open addressing with linear probing over a single array of buckets that is
+* allocated once, so insert and remove never touch the allocator. Removal
+* shifts the following entries back instead of leaving tombstones.
+*
 * @warning This class is not threadsafe.
 */
 class BufHashTbl
 {
  private:
 	/**
-	 *	Size of Hash Table
+	 *	Number of buckets, a power of two at least twice the number of entries
+	 */
+  std::uint32_t HTSIZE;
+
+	/**
+	 *	Number of entries the table was sized for
+	 */
+  std::uint32_t maxEntries;
+
+	/**
+	 *	Number of entries currently in the table
 	 */
-  int HTSIZE;
+  std::uint32_t numEntries;
+
 	/**
 	 * Actual Hash table object
 	 */
-  hashBucket**  ht;
+  hashBucket*  ht;
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * returns hash value between 0 and HTSIZE-1 computed using the file's id and pageNo
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  std::uint32_t hash(const File* file, const PageId pageNo) const;
+
+	/**
+	 * returns the bucket holding (file, pageNo), or the empty bucket ending its probe sequence
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Index of the bucket.
+	 */
+  std::uint32_t probe(const File* file, const PageId pageNo) const;
 
  public:
 	/**
    * Constructor of BufHashTbl class
+	 *
+	 * @param htSize  Most entries the table will hold at once, normally the number of buffer frames
 	 */
 	BufHashTbl(const int htSize);  // constructor
 
@@ -81,7 +102,7 @@ class BufHashTbl
 	 * @param pageNo 	Page number in the file
 	 * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as running of memory
+   * @throws  HashTableException if the table already holds htSize entries
 	 */
   void insert(const File* file, const PageId pageNo, const FrameId frameNo);
 
@@ -96,6 +117,17 @@ class BufHashTbl
 	 */
   void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
 
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool, reporting a miss
+   * through the return value instead of an exception.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, only set if the page is found
+   * @return  True if the page entry is found in the hash table
+	 */
+  bool tryLookup(const File* file, const PageId pageNo, FrameId &frameNo);
+
 	/**
    * Delete entry (file,pageNo) from hash table.
 	 *
@@ -7,6 +7,9 @@
 
 #include <memory>
 #include <iostream>
+#include <algorithm>
+#include <thread>
+#include <chrono>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
@@ -16,12 +19,15 @@
 
 namespace badgerdb { 
 
+const FrameId BufMgr::NO_FRAME;
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
+BufMgr::BufMgr(std::uint32_t bufs, const Replacement replacement)
+	: numBufs(bufs), writerStop(false), writerInterval(0), writerMaxPages(0), writerDirtyRatio(0),
+	  prefetchStop(false) {
 	bufDescTable = new BufDesc[bufs];
 
   for (FrameId i = 0; i < bufs; i++) 
@@ -32,121 +38,481 @@ BufMgr::BufMgr(std::uint32_t bufs)
 
   bufPool = new Page[bufs];
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+  // any partition may end up holding every frame
+  for (std::uint32_t i = 0; i < NUM_PARTITIONS; i++)
+    partitions[i].hashTable = new BufHashTbl (bufs);  // allocate the buffer hash tables
+
+  policy = ReplacementPolicy::create(replacement, bufDescTable, bufs);
 
-  clockHand = bufs - 1;
+  for (std::uint32_t i = 0; i < NUM_PREFETCHERS; i++)
+    prefetchFiles[i] = NULL;
 }
 
 
 BufMgr::~BufMgr() {
-  //Flush out all unwritten pages
+  {
+    std::lock_guard<std::mutex> guard(prefetchMutex);
+    prefetchStop = true;
+    prefetchQueue.clear();
+  }
+  prefetchWake.notify_all();
+  for (std::uint32_t i = 0; i < NUM_PREFETCHERS; i++)
+    if (prefetchers[i].joinable())
+      prefetchers[i].join();
+  stopBackgroundWriter();
+
+  //Flush out all unwritten pages, grouped by file and in page order
+  std::vector<std::pair<std::pair<std::uint32_t, PageId>, FrameId> > dirtyFrames;
   for (std::uint32_t i = 0; i < numBufs; i++) 
   {
   	BufDesc* tmpbuf = &bufDescTable[i];
   	if (tmpbuf->valid == true && tmpbuf->dirty == true)
+			dirtyFrames.push_back(std::make_pair(std::make_pair(tmpbuf->file.load()->id(), tmpbuf->pageNo), i));
+  }
+  std::sort(dirtyFrames.begin(), dirtyFrames.end());
+  std::vector<FrameId> fileFrames;
+  for (std::size_t n = 0; n < dirtyFrames.size(); n++)
+  {
+  	fileFrames.push_back(dirtyFrames[n].second);
+  	if (n + 1 == dirtyFrames.size() || dirtyFrames[n + 1].first.first != dirtyFrames[n].first.first)
 		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-  	}
+			writeDirtyFrames(fileFrames);
+			fileFrames.clear();
+		}
   }
 
+  delete policy;
   delete [] bufDescTable;
   delete [] bufPool;
+  for (std::uint32_t i = 0; i < NUM_PARTITIONS; i++)
+    delete partitions[i].hashTable;
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+void BufMgr::allocBuf(FrameId & frame, const File* file, const PageId pageNo) 
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+  if (!tryAllocBuf(frame, file, pageNo))
+    throw BufferExceededException();
+}
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+bool BufMgr::tryAllocBuf(FrameId & frame, const File* file, const PageId pageNo) 
+{
+  for (std::uint32_t numTried = 0; numTried < numBufs; numTried++)
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
-
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+    // the policy hands out the frame already claimed
+    if (!policy->pickVictim(file, pageNo, frame))
+      return false;
+
+    // if invalid, use frame; otherwise remove previous entry from the page table
+    if (!bufDescTable[frame].valid)
+      return true;
+    if (evictFrame(frame))
     {
-      break;
+      policy->evicted(frame);
+      return true;
     }
+    // pinned again meanwhile, which counts as a reference
+    bufDescTable[frame].pinCnt -= BufDesc::CLAIMED;
+    policy->accessed(frame);
+  }
+
+  // the buffer pool is full
+  return false;
+} // end tryAllocBuf
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+bool BufMgr::tryAllocRingBuf(BufferRing& ring, FrameId & frame, const File* file, const PageId pageNo)
+{
+  if (ring.frames.size() == ring.capacity)
+  {
+    // the oldest frame of the ring is only ours to recycle while it still
+    // holds our page; the pool may have handed it to someone else since
+    FrameId oldest = ring.frames[ring.next];
+    BufDesc& desc = bufDescTable[oldest];
+    int expected = 0;
+    if (desc.pinCnt.compare_exchange_strong(expected, BufDesc::CLAIMED))
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
+      if (desc.valid && desc.ring == &ring)
       {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
+        if (evictFrame(oldest))
+        {
+          policy->evicted(oldest);
+          ring.next = (ring.next + 1) % ring.capacity;
+          frame = oldest;
+          return true;
+        }
+        // pinned again meanwhile, which counts as a reference
+        desc.pinCnt -= BufDesc::CLAIMED;
+        policy->accessed(oldest);
       }
+      else desc.pinCnt -= BufDesc::CLAIMED;
     }
-    else
+  }
+
+  // take a frame from the pool and make it part of the ring
+  if (!tryAllocBuf(frame, file, pageNo))
+    return false;
+  if (ring.frames.size() < ring.capacity)
+    ring.frames.push_back(frame);
+  else
+  {
+    ring.frames[ring.next] = frame;
+    ring.next = (ring.next + 1) % ring.capacity;
+  }
+  return true;
+}
+
+bool BufMgr::evictFrame(const FrameId frame)
+{
+  BufDesc& desc = bufDescTable[frame];
+  File* file = desc.file;
+
+  // flush any existing changes to disk if necessary; a thread writing the
+  // page right now holds its latch, so skip the frame rather than wait
+  if (desc.dirty)
+  {
+    if (!desc.latch.tryLockShared())
+      return false;
+    desc.dirty = false;
+    try
     {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      file->writePage(desc.pageNo, bufPool[frame]);
     }
+    catch (...)
+    {
+      // the page stays in its frame, dirty and free for anyone to use
+      desc.dirty = true;
+      desc.latch.unlock();
+      desc.pinCnt -= BufDesc::CLAIMED;
+      throw;
+    }
+    bufStats.diskwrites++;
+    desc.latch.unlock();
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+
+  // pins are only taken under the partition mutex, so nobody can pin the
+  // page once it is checked and removed here
+  PageTablePartition& partition = partitionFor(file, desc.pageNo);
+  std::lock_guard<std::mutex> guard(partition.mutex);
+  if (desc.pinCnt != BufDesc::CLAIMED || desc.dirty)
+    return false;
+  unmapFrame(partition, file, desc.pageNo, frame);
+  return true;
+}
+
+void BufMgr::mapFrame(PageTablePartition& partition, const File* file, const PageId pageNo, const FrameId frameNo)
+{
+  partition.hashTable->insert(file, pageNo, frameNo);
+  FrameId& head = partition.fileFrames.insert(std::make_pair(file, NO_FRAME)).first->second;
+  bufDescTable[frameNo].filePrev = NO_FRAME;
+  bufDescTable[frameNo].fileNext = head;
+  if (head != NO_FRAME)
+    bufDescTable[head].filePrev = frameNo;
+  head = frameNo;
+}
+
+void BufMgr::unmapFrame(PageTablePartition& partition, const File* file, const PageId pageNo, const FrameId frameNo)
+{
+  partition.hashTable->remove(file, pageNo);
+  BufDesc& desc = bufDescTable[frameNo];
+  if (desc.fileNext != NO_FRAME)
+    bufDescTable[desc.fileNext].filePrev = desc.filePrev;
+  if (desc.filePrev != NO_FRAME)
+    bufDescTable[desc.filePrev].fileNext = desc.fileNext;
+  else if (desc.fileNext != NO_FRAME)
+    partition.fileFrames[file] = desc.fileNext;
+  else
+    partition.fileFrames.erase(file);
+}
+
+bool BufMgr::cleanFrame(const FrameId frame)
+{
+  BufDesc& desc = bufDescTable[frame];
+  if (!desc.dirty)
+    return false;
+
+  // claim the frame so it is neither evicted nor reused while it is written
+  int expected = 0;
+  if (!desc.pinCnt.compare_exchange_strong(expected, BufDesc::CLAIMED))
+    return false;
+
+  bool written = false;
+  if (desc.valid && desc.dirty && desc.latch.tryLockShared())
   {
-    throw BufferExceededException();
+    // whoever pins and dirties the page meanwhile marks it dirty again
+    desc.dirty = false;
+    try
+    {
+      desc.file.load()->writePage(desc.pageNo, bufPool[frame]);
+      bufStats.diskwrites++;
+      bufStats.bgwrites++;
+      written = true;
+    }
+    catch (...)
+    {
+      // leave the page to be written on eviction, which reports the failure
+      desc.dirty = true;
+    }
+    desc.latch.unlock();
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+  desc.pinCnt -= BufDesc::CLAIMED;
+  return written;
+}
+
+std::uint32_t BufMgr::writeBackRound()
+{
+  std::uint32_t dirtyFrames = 0;
+  for (std::uint32_t i = 0; i < numBufs; i++)
+    dirtyFrames += bufDescTable[i].dirty;
+  std::uint32_t dirtyTarget = (std::uint32_t) (writerDirtyRatio * numBufs);
+
+  std::vector<FrameId> victims;
+  policy->evictionCandidates(victims, numBufs);
+  std::uint32_t written = 0;
+  for (std::uint32_t i = 0; i < victims.size() && written < writerMaxPages; i++)
   {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    // past the frames due for eviction soon, only go on while the pool is too dirty
+    if (i >= writerMaxPages && dirtyFrames <= dirtyTarget)
+      break;
+    if (cleanFrame(victims[i]))
+    {
+      written++;
+      if (dirtyFrames > 0)
+        dirtyFrames--;
+    }
+  }
+  return written;
+}
+
+void BufMgr::backgroundWriter()
+{
+  std::unique_lock<std::mutex> lock(writerMutex);
+  while (!writerStop)
+  {
+    lock.unlock();
+    writeBackRound();
+    lock.lock();
+    // a spurious wakeup merely starts the next round early
+    if (!writerStop)
+      writerWake.wait_for(lock, std::chrono::milliseconds(writerInterval));
   }
+}
 
-	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+void BufMgr::startBackgroundWriter(const std::uint32_t intervalMs, const std::uint32_t maxPagesPerRound, const double dirtyRatio)
+{
+  stopBackgroundWriter();
+  writerStop = false;
+  writerInterval = intervalMs;
+  writerMaxPages = maxPagesPerRound;
+  writerDirtyRatio = dirtyRatio;
+  writer = std::thread(&BufMgr::backgroundWriter, this);
+}
 
-  // return new frame number
-  frame = clockHand;
-} // end allocBuf
+void BufMgr::stopBackgroundWriter()
+{
+  if (!writer.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> guard(writerMutex);
+    writerStop = true;
+  }
+  writerWake.notify_all();
+  writer.join();
+}
 
 	
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page, BufferRing* ring)
 {
-  // check to see if it is already in the buffer pool
-  // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
-  FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  if (!tryReadPage(file, pageNo, page, ring))
+    throw BufferExceededException();
+}
+
+PageHandle BufMgr::readPage(File* file, const PageId pageNo, BufferRing* ring)
+{
+  Page* page;
+  readPage(file, pageNo, page, ring);
+  return PageHandle(this, page - bufPool, page);
+}
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
+bool BufMgr::tryReadPage(File* file, const PageId pageNo, Page*& page, BufferRing* ring)
+{
+  PageTablePartition& partition = partitionFor(file, pageNo);
+  FrameId frameNo = 0;
+  bufStats.accesses++;
+  while (true)
+  {
+    // check to see if it is already in the buffer pool
+    std::unique_lock<std::mutex> guard(partition.mutex);
+    if (partition.hashTable->tryLookup(file, pageNo, frameNo))
+    {
+      BufDesc& desc = bufDescTable[frameNo];
+      desc.pinCnt++;
+      guard.unlock();
+      // bulk readers do not make a page look hot
+      if (ring == NULL)
+        policy->accessed(frameNo);
+
+      // wait for the thread reading the page in, if any
+      desc.ioLatch.lockShared();
+      bool loaded = desc.valid;
+      desc.ioLatch.unlock();
+      if (loaded)
+      {
+        bufStats.hits++;
+        page = &bufPool[frameNo];
+        return true;
+      }
+      // the read failed; retry it ourselves
+      desc.pinCnt--;
+      continue;
+    }
+    guard.unlock();
+
+    //not in the buffer pool, must allocate a new page
+    if (ring != NULL ? !tryAllocRingBuf(*ring, frameNo, file, pageNo) : !tryAllocBuf(frameNo, file, pageNo))
+      return false;
+    // another thread may have read it in meanwhile, in which case we use its frame
+    if (!installPage(frameNo, file, pageNo, ring, true))
+      continue;
+    bufStats.misses++;
     page = &bufPool[frameNo];
+    return true;
   }
-  catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
-  {
-    // alloc a new frame
-    allocBuf(frameNo);
+}
+
+bool BufMgr::installPage(const FrameId frameNo, File* file, const PageId pageNo, const BufferRing* ring, const bool pin)
+{
+  PageTablePartition& partition = partitionFor(file, pageNo);
+  BufDesc& desc = bufDescTable[frameNo];
+  FrameId found = 0;
 
-    // read the page into the new frame
+  std::unique_lock<std::mutex> guard(partition.mutex);
+  if (partition.hashTable->tryLookup(file, pageNo, found))
+  {
+    policy->removed(frameNo);
+    desc.Clear();
+    return false;
+  }
+  // set up the entry properly and publish it; threads finding it wait until the read is done
+  desc.Set(file, pageNo);
+  desc.ring = ring;
+  desc.ioLatch.lockExclusive();
+  mapFrame(partition, file, pageNo, frameNo);
+  guard.unlock();
+
+  // read the page into the new frame
+  try
+  {
     bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+    file->readPageInto(pageNo, &bufPool[frameNo]);
+  }
+  catch (...)
+  {
+    guard.lock();
+    unmapFrame(partition, file, pageNo, frameNo);
+    guard.unlock();
+    policy->removed(frameNo);
+    desc.valid = false;
+    desc.ioLatch.unlock();
+    // the frame is free again once the waiters have dropped their pins too
+    desc.file = NULL;
+    desc.pinCnt--;
+    throw;
+  }
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+  // pages read for a bulk reader or ahead of need are not referenced yet
+  if (ring != NULL || !pin)
+    policy->loadedCold(frameNo, file, pageNo);
+  else
+    policy->loaded(frameNo, file, pageNo);
+  // a prefetched page drops its pin before disposePage() can see the read is done
+  if (!pin)
+    desc.pinCnt--;
+  desc.ioLatch.unlock();
+  return true;
+}
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+bool BufMgr::tryPrefetch(File* file, const PageId pageNo)
+{
+  PageTablePartition& partition = partitionFor(file, pageNo);
+  FrameId frameNo = 0;
+  {
+    std::lock_guard<std::mutex> guard(partition.mutex);
+    if (partition.hashTable->tryLookup(file, pageNo, frameNo))
+      return false;
+  }
+  if (!tryAllocBuf(frameNo, file, pageNo))
+    return false;
+  try
+  {
+    if (!installPage(frameNo, file, pageNo, NULL, false))
+      return false;
+  }
+  catch (...)
+  {
+    return false;
+  }
+  bufStats.prefetches++;
+  return true;
+}
+
+void BufMgr::prefetcher(const std::uint32_t slot)
+{
+  std::unique_lock<std::mutex> lock(prefetchMutex);
+  while (true)
+  {
+    while (!prefetchStop && prefetchQueue.empty())
+      prefetchWake.wait(lock);
+    if (prefetchStop)
+      return;
+    std::pair<File*, PageId> request = prefetchQueue.front();
+    prefetchQueue.pop_front();
+    prefetchFiles[slot] = request.first;
+    lock.unlock();
+
+    tryPrefetch(request.first, request.second);
+
+    lock.lock();
+    prefetchFiles[slot] = NULL;
+    prefetchDone.notify_all();
+  }
+}
+
+void BufMgr::prefetchPage(File* file, const PageId pageNo)
+{
+  prefetchPages(file, std::vector<PageId>(1, pageNo));
+}
+
+void BufMgr::prefetchPages(File* file, const std::vector<PageId>& pageNos)
+{
+  {
+    std::lock_guard<std::mutex> guard(prefetchMutex);
+    if (prefetchStop)
+      return;
+    if (!prefetchers[0].joinable())
+    {
+      for (std::uint32_t i = 0; i < NUM_PREFETCHERS; i++)
+        prefetchers[i] = std::thread(&BufMgr::prefetcher, this, i);
+    }
+    for (std::size_t i = 0; i < pageNos.size() && prefetchQueue.size() < numBufs; i++)
+      prefetchQueue.push_back(std::make_pair(file, pageNos[i]));
+  }
+  prefetchWake.notify_all();
+}
+
+void BufMgr::cancelPrefetches(const File* file)
+{
+  std::unique_lock<std::mutex> lock(prefetchMutex);
+  std::deque<std::pair<File*, PageId> >::iterator it = prefetchQueue.begin();
+  while (it != prefetchQueue.end())
+  {
+    if (it->first == file)
+      it = prefetchQueue.erase(it);
+    else
+      ++it;
+  }
+  for (std::uint32_t i = 0; i < NUM_PREFETCHERS; i++)
+  {
+    while (prefetchFiles[i] == file)
+      prefetchDone.wait(lock);
   }
 }
 
@@ -154,56 +520,240 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 void BufMgr::unPinPage(File* file, const PageId pageNo, 
 			     const bool dirty) 
 {
+  PageTablePartition& partition = partitionFor(file, pageNo);
+  std::lock_guard<std::mutex> guard(partition.mutex);
   // lookup in hashtable
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  partition.hashTable->lookup(file, pageNo, frameNo);
 
   if (dirty == true) bufDescTable[frameNo].dirty = dirty;
 
   // make sure the page is actually pinned
-  if (bufDescTable[frameNo].pinCnt == 0)
+  if ((bufDescTable[frameNo].pinCnt & ~BufDesc::CLAIMED) == 0)
   {
   	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
   }
   else bufDescTable[frameNo].pinCnt--;
 }
 
+void BufMgr::unPinPage(const Page* page, const bool dirty)
+{
+  FrameId frameNo = page - bufPool;
+  if (!tryUnPinFrame(frameNo, dirty))
+  {
+    static const std::string noFile;
+    File* file = bufDescTable[frameNo].file;
+    throw PageNotPinnedException(file != NULL ? file->filename() : noFile, bufDescTable[frameNo].pageNo, frameNo);
+  }
+}
+
+bool BufMgr::tryUnPinFrame(const FrameId frameNo, const bool dirty)
+{
+  // the caller's pin keeps the frame from changing hands, so no partition
+  // mutex is needed; dropping a pin only ever lets an evictor in
+  BufDesc& desc = bufDescTable[frameNo];
+  int pinCnt = desc.pinCnt;
+  do
+  {
+    if ((pinCnt & ~BufDesc::CLAIMED) == 0)
+      return false;
+    // marked before the pin is dropped, so whoever claims the frame next sees it
+    if (dirty == true) desc.dirty = true;
+  } while (!desc.pinCnt.compare_exchange_weak(pinCnt, pinCnt - 1));
+  return true;
+}
+
+PageHandle& PageHandle::operator=(PageHandle&& other)
+{
+  if (this != &other)
+  {
+    release();
+    bufMgr = other.bufMgr;
+    frameNo = other.frameNo;
+    page = other.page;
+    dirty = other.dirty;
+    other.page = NULL;
+  }
+  return *this;
+}
+
+void PageHandle::release()
+{
+  if (page == NULL)
+    return;
+  bufMgr->tryUnPinFrame(frameNo, dirty);
+  page = NULL;
+  dirty = false;
+}
+
+bool BufMgr::tryUnPinPage(File* file, const PageId pageNo, const bool dirty)
+{
+  PageTablePartition& partition = partitionFor(file, pageNo);
+  std::lock_guard<std::mutex> guard(partition.mutex);
+  FrameId frameNo = 0;
+  if (!partition.hashTable->tryLookup(file, pageNo, frameNo)
+      || (bufDescTable[frameNo].pinCnt & ~BufDesc::CLAIMED) == 0)
+    return false;
+
+  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+  bufDescTable[frameNo].pinCnt--;
+  return true;
+}
+
 void BufMgr::flushFile(const File* file) 
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
+  // a prefetch finishing later would bring a page of the file back in
+  cancelPrefetches(file);
+
+  // gather the frames of the file, in page order so the writes can be merged
+  std::vector<std::pair<PageId, FrameId> > frames;
+  for (std::uint32_t p = 0; p < NUM_PARTITIONS; p++)
+  {
+    std::lock_guard<std::mutex> guard(partitions[p].mutex);
+    std::unordered_map<const File*, FrameId>::const_iterator head = partitions[p].fileFrames.find(file);
+    if (head == partitions[p].fileFrames.end())
+      continue;
+    for (FrameId f = head->second; f != NO_FRAME; f = bufDescTable[f].fileNext)
+      frames.push_back(std::make_pair(bufDescTable[f].pageNo, f));
+  }
+  std::sort(frames.begin(), frames.end());
+
+  // claim every frame first, so that the dirty ones can be written together
+  std::vector<FrameId> claimed;
+  for (std::size_t n = 0; n < frames.size(); n++)
 	{
+  	FrameId i = frames[n].second;
   	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->valid == true && tmpbuf->file == file)
+
+  	// claim the frame so it cannot change hands while it is written out
+  	int expected = 0;
+  	if (!tmpbuf->pinCnt.compare_exchange_strong(expected, BufDesc::CLAIMED))
 		{
-	    if (tmpbuf->pinCnt > 0)
+	    if ((expected & ~BufDesc::CLAIMED) > 0)
+			{
+				releaseClaims(claimed);
   			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+			}
+	    // the clock sweep is evicting it; look at the frame again once it is done
+	    std::this_thread::yield();
+	    n--;
+	    continue;
+		}
+
+  	// the frame may have been evicted and reused since it was gathered
+  	if (tmpbuf->file != file || tmpbuf->pageNo != frames[n].first)
+		{
+	    tmpbuf->pinCnt -= BufDesc::CLAIMED;
+	    continue;
+		}
 
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
-
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
-  	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
+  	if (tmpbuf->valid == false)
+		{
+			tmpbuf->pinCnt -= BufDesc::CLAIMED;
+			releaseClaims(claimed);
   		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+		}
+		claimed.push_back(i);
+  }
+
+  try
+  {
+    writeDirtyFrames(claimed);
+  }
+  catch (...)
+  {
+    releaseClaims(claimed);
+    throw;
+  }
+
+  for (std::size_t n = 0; n < claimed.size(); n++)
+	{
+  	FrameId i = claimed[n];
+  	BufDesc* tmpbuf = &(bufDescTable[i]);
+    PageTablePartition& partition = partitionFor(file, tmpbuf->pageNo);
+    {
+    	std::lock_guard<std::mutex> guard(partition.mutex);
+    	unmapFrame(partition, file, tmpbuf->pageNo, i);
+    }
+  	policy->removed(i);
+  	tmpbuf->Clear();
+  }
+}
+
+void BufMgr::releaseClaims(const std::vector<FrameId>& frames)
+{
+  for (std::size_t n = 0; n < frames.size(); n++)
+    bufDescTable[frames[n]].pinCnt -= BufDesc::CLAIMED;
+}
+
+void BufMgr::writeDirtyFrames(const std::vector<FrameId>& frames)
+{
+  File* written = NULL;
+  std::vector<FrameId> run;
+  for (std::size_t n = 0; n <= frames.size(); n++)
+  {
+    // a run ends at the first page that is clean or does not follow on
+    BufDesc* tmpbuf = n < frames.size() ? &bufDescTable[frames[n]] : NULL;
+    bool extends = tmpbuf != NULL && tmpbuf->dirty
+        && (run.empty() || tmpbuf->pageNo == bufDescTable[run.back()].pageNo + 1);
+    if (!extends && !run.empty())
+    {
+      std::vector<const Page*> pages;
+      for (std::size_t r = 0; r < run.size(); r++)
+        pages.push_back(&bufPool[run[r]]);
+      written = bufDescTable[run[0]].file.load();
+      written->writePages(bufDescTable[run[0]].pageNo, pages);
+      for (std::size_t r = 0; r < run.size(); r++)
+        bufDescTable[run[r]].dirty = false;
+      run.clear();
+    }
+    if (tmpbuf != NULL && tmpbuf->dirty)
+      run.push_back(frames[n]);
   }
+  if (written != NULL)
+    written->sync();
 }
 
 void BufMgr::disposePage(File* file, const PageId pageNo) 
 {
 	//Deallocate from file altogether
   //See if it is in the buffer pool
+  PageTablePartition& partition = partitionFor(file, pageNo);
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  while (true)
+  {
+    std::unique_lock<std::mutex> guard(partition.mutex);
+    if (!partition.hashTable->tryLookup(file, pageNo, frameNo))
+      break;
+
+    // a page still being read in, maybe by a prefetch holding the only pin,
+    // is left to its reader until the read is done
+    BufDesc& desc = bufDescTable[frameNo];
+    if (!desc.ioLatch.tryLockShared())
+    {
+      guard.unlock();
+      std::this_thread::yield();
+      continue;
+    }
+    desc.ioLatch.unlock();
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+    // pins held by the caller are dropped with the page, but a frame the
+    // clock sweep has claimed must be left to it until it gives up or evicts
+    int pinCnt = 0;
+    if (!desc.pinCnt.compare_exchange_strong(pinCnt, BufDesc::CLAIMED)
+        && pinCnt >= BufDesc::CLAIMED)
+    {
+      guard.unlock();
+      std::this_thread::yield();
+      continue;
+    }
 
-	hashTable->remove(file, pageNo);
+	  unmapFrame(partition, file, pageNo, frameNo);
+	  policy->removed(frameNo);
+	  // clear the page
+	  desc.Clear();
+    break;
+  }
 
   // deallocate it in the file	
   file->deletePage(pageNo);
@@ -215,18 +765,39 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
   FrameId frameNo;
 
   // alloc a new frame
-  allocBuf(frameNo);
+  allocBuf(frameNo, NULL, Page::INVALID_NUMBER);
 
   // allocate a new page in the file
 	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
+  try
+  {
+    file->allocatePageInto(pageNo, &bufPool[frameNo]);
+  }
+  catch (...)
+  {
+    policy->removed(frameNo);
+    bufDescTable[frameNo].Clear();
+    throw;
+  }
   page = &bufPool[frameNo];
 
   // set up the entry properly
   bufDescTable[frameNo].Set(file, pageNo);
 
   // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+  PageTablePartition& partition = partitionFor(file, pageNo);
+  std::lock_guard<std::mutex> guard(partition.mutex);
+  mapFrame(partition, file, pageNo, frameNo);
+  policy->loaded(frameNo, file, pageNo);
+}
+
+PageHandle BufMgr::allocPage(File* file, PageId &pageNo)
+{
+  Page* page;
+  allocPage(file, pageNo, page);
+  PageHandle handle(this, page - bufPool, page);
+  handle.markDirty();
+  return handle;
 }
 
 void BufMgr::printSelf(void) 
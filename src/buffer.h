@@ -9,7 +9,17 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "latch.h"
+#include "replacement.h"
 #include <iostream>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <utility>
+#include <unordered_map>
 
 namespace badgerdb {
 
@@ -17,6 +27,7 @@ namespace badgerdb {
 * forward declaration of BufMgr class 
 */
 class BufMgr;
+class BufferRing;
 
 /**
 * @brief Class for maintaining information about buffer pool frames
@@ -24,12 +35,20 @@ class BufMgr;
 class BufDesc {
 
 	friend class BufMgr;
+	friend class ReplacementPolicy;
 
  private:
+	/**
+   * Added to pinCnt by a thread that has claimed the frame to evict or reuse it.
+   * Other threads only pin a claimed frame through the page table, which
+   * tells the claimer that the frame is still in use.
+	 */
+  static const int CLAIMED = 1 << 30;
+
 	/**
    * Pointer to file to which corresponding frame is assigned
 	 */
-  File* file;
+  std::atomic<File*> file;
 
 	/**
    * Page within file to which corresponding frame is assigned
@@ -42,14 +61,14 @@ class BufDesc {
   FrameId	frameNo;
 
 	/**
-   * Number of times this page has been pinned
+   * Number of times this page has been pinned, plus CLAIMED while a thread owns the frame
 	 */
-  int pinCnt;
+  std::atomic<int> pinCnt;
 
 	/**
    * True if page is dirty;  false otherwise
 	 */
-  bool dirty;
+  std::atomic<bool> dirty;
 
 	/**
    * True if page is valid
@@ -59,19 +78,46 @@ class BufDesc {
 	/**
    * Has this buffer frame been reference recently
 	 */
-  bool refbit;
+  std::atomic<bool> refbit;
+
+	/**
+   * Latch guarding the contents of the page held in this frame.
+   * Only taken by callers that have the page pinned.
+	 */
+  RWLatch latch;
+
+	/**
+   * Ring whose reader brought the page in, NULL for pages read through the pool.
+   * Only compared against, never dereferenced.
+	 */
+  std::atomic<const BufferRing*> ring;
 
 	/**
-   * Initialize buffer frame for a new user
+   * Previous and next frame in the list of frames of the same file in the same
+   * page table partition, guarded by the partition mutex
+	 */
+  FrameId filePrev;
+  FrameId fileNext;
+
+	/**
+   * Held exclusive while the page is being read into this frame.
+   * Threads that find the page in the page table wait on it before using the frame.
+	 */
+  RWLatch ioLatch;
+
+	/**
+   * Initialize buffer frame for a new user. Dropping the pin count comes last,
+   * since that is what lets the clock sweep claim the frame again.
 	 */
   void Clear()
 	{
-    pinCnt = 0;
 		file = NULL;
 		pageNo = Page::INVALID_NUMBER;
     dirty = false;
     refbit = false;
 		valid = false;
+    ring = NULL;
+    pinCnt = 0;
   };
 
 	/**
@@ -89,13 +135,14 @@ class BufDesc {
     dirty = false;
     valid = true;
     refbit = true;
+    ring = NULL;
   }
 
   void Print()
 	{
 		if(file != NULL)
 		{
-			std::cout << "file:" << file->filename() << " ";
+			std::cout << "file:" << file.load()->filename() << " ";
 			std::cout << "pageNo:" << pageNo << " ";
 		}
 		else
@@ -125,24 +172,52 @@ struct BufStats
 	/**
    * Total number of accesses to buffer pool
 	 */
-  int accesses;
+  std::atomic<int> accesses;
+
+	/**
+   * Number of accesses that found the page in the buffer pool
+	 */
+  std::atomic<int> hits;
+
+	/**
+   * Number of accesses that had to bring the page in
+	 */
+  std::atomic<int> misses;
 
 	/**
    * Number of pages read from disk (including allocs)
 	 */
-  int diskreads;
+  std::atomic<int> diskreads;
 
 	/**
    * Number of pages written back to disk
 	 */
-  int diskwrites;
+  std::atomic<int> diskwrites;
+
+	/**
+   * Number of those writes done by the background writer rather than on eviction
+	 */
+  std::atomic<int> bgwrites;
+
+	/**
+   * Number of pages brought in by prefetching, ahead of their first access
+	 */
+  std::atomic<int> prefetches;
 
 	/**
    * Clear all values 
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses = hits = misses = diskreads = diskwrites = bgwrites = prefetches = 0;
+  }
+
+	/**
+   * Fraction of accesses that found the page in the buffer pool, 0 if there were none
+	 */
+  double hitRatio() const
+  {
+		return accesses > 0 ? (double) hits / accesses : 0;
   }
       
 	/**
@@ -155,16 +230,200 @@ struct BufStats
 };
 
 
+/**
+* @brief Small ring of frames a bulk reader, such as a sequential scan, recycles
+* for the pages it reads.
+*
+* Pages read through a ring are handed to the replacement policy as the first
+* to evict, and once the ring has filled up its reader reuses its own oldest
+* frame rather than taking one from the rest of the pool. A scan over a large
+* relation therefore leaves the pool's working set alone. A ring belongs to a
+* single reader and is not threadsafe.
+*/
+class BufferRing
+{
+	friend class BufMgr;
+
+ public:
+	/**
+   * Default number of frames in a ring
+	 */
+  static const std::uint32_t DEFAULT_SIZE = 16;
+
+	/**
+   * Constructor of BufferRing class
+	 *
+	 * @param size  	Most frames the ring holds
+	 */
+  BufferRing(const std::uint32_t size = DEFAULT_SIZE)
+    : capacity(size > 0 ? size : 1), next(0) {}
+
+ private:
+	/**
+   * Most frames the ring holds
+	 */
+  std::uint32_t capacity;
+
+	/**
+   * Index in frames of the frame to recycle next, once the ring is full
+	 */
+  std::uint32_t next;
+
+	/**
+   * Frames the ring has read pages into, oldest first from next
+	 */
+  std::vector<FrameId> frames;
+};
+
+
+/**
+* @brief A pin on a page in the buffer pool, dropped when the handle goes out
+* of scope or is released.
+*
+* The handle knows the frame of its page, so unpinning it does not go through
+* the page table. The page is marked dirty on unpin only if markDirty() was
+* called. Handles can be moved but not copied; a handle that was moved from,
+* released, or default constructed holds no page.
+*/
+class PageHandle
+{
+	friend class BufMgr;
+
+ public:
+	/**
+   * Constructor of an empty PageHandle
+	 */
+  PageHandle() : bufMgr(NULL), frameNo(0), page(NULL), dirty(false) {}
+
+	/**
+   * Take over the pin held by another handle
+	 */
+  PageHandle(PageHandle&& other)
+    : bufMgr(other.bufMgr), frameNo(other.frameNo), page(other.page), dirty(other.dirty)
+  {
+		other.page = NULL;
+  }
+
+	/**
+   * Drop the pin held by this handle, if any, and take over the one held by another
+	 */
+  PageHandle& operator=(PageHandle&& other);
+
+	/**
+   * Destructor of PageHandle class, drops the pin if the handle still holds one
+	 */
+  ~PageHandle()
+  {
+		release();
+  }
+
+	/**
+   * Returns the pinned page, NULL if the handle holds none
+	 */
+  Page* get() const
+  {
+		return page;
+  }
+
+  Page* operator->() const
+  {
+		return page;
+  }
+
+	/**
+   * Returns true if the handle holds a pin
+	 */
+  explicit operator bool() const
+  {
+		return page != NULL;
+  }
+
+	/**
+   * Have the page marked dirty when the pin is dropped
+	 */
+  void markDirty()
+  {
+		dirty = true;
+  }
+
+	/**
+   * Drop the pin now rather than when the handle goes out of scope
+	 */
+  void release();
+
+ private:
+  PageHandle(BufMgr* bufMgr, const FrameId frameNo, Page* page)
+    : bufMgr(bufMgr), frameNo(frameNo), page(page), dirty(false) {}
+
+  PageHandle(const PageHandle&);
+  PageHandle& operator=(const PageHandle&);
+
+	/**
+   * Buffer manager holding the page
+	 */
+  BufMgr* bufMgr;
+
+	/**
+   * Frame holding the page
+	 */
+  FrameId frameNo;
+
+	/**
+   * The pinned page, NULL if the handle holds none
+	 */
+  Page* page;
+
+	/**
+   * True if the page is to be marked dirty when it is unpinned
+	 */
+  bool dirty;
+};
+
+
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* All public methods may be called concurrently from several threads. The pool
+* itself does not latch page contents; threads sharing a page coordinate
+* through latchPage() and unlatchPage() while they have it pinned.
+*
+* The page table is split into partitions with a mutex each, pin counts and
+* reference bits are atomic, and victims are claimed with a compare-and-swap
+* on their pin count. Which frame to reuse is left to a ReplacementPolicy
+* picked at construction. Files are called into without a lock of the pool's;
+* they serialize what needs serializing themselves.
 */
 class BufMgr 
 {
+	friend class PageHandle;
+
  private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Number of page table partitions
+	 */
+  static const std::uint32_t NUM_PARTITIONS = 16;
+
+	/**
+   * Marks the end of a list of frames
+	 */
+  static const FrameId NO_FRAME = ~0u;
+
+	/**
+   * One partition of the page table with the mutex guarding it. Besides the
+   * hash table it keeps the frames of each file in a list, linked through
+   * the frames, so that a file's pages are found without a pool sweep.
 	 */
-  FrameId clockHand;
+  struct PageTablePartition
+  {
+    std::mutex mutex;
+    BufHashTbl *hashTable;
+    std::unordered_map<const File*, FrameId> fileFrames;
+  };
+
+	/**
+   * Policy choosing the frames to reuse
+	 */
+  ReplacementPolicy *policy;
 
 	/**
    * Number of frames in the buffer pool
@@ -172,9 +431,9 @@ class BufMgr
   std::uint32_t numBufs;
 	
 	/**
-   * Hash table mapping (File, page) to frame
+   * Hash tables mapping (File, page) to frame, partitioned by (File, page)
 	 */
-  BufHashTbl *hashTable;
+  PageTablePartition partitions[NUM_PARTITIONS];
 
 	/**
    * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
@@ -187,22 +446,232 @@ class BufMgr
   BufStats bufStats;
 
 	/**
-	 * Allocate a free frame.  
+   * Background writer thread, not joinable while no writer is running
+	 */
+  std::thread writer;
+
+	/**
+   * Guards writerStop and lets the writer sleep between rounds
+	 */
+  std::mutex writerMutex;
+  std::condition_variable writerWake;
+
+	/**
+   * Set to tell the background writer to finish
+	 */
+  bool writerStop;
+
+	/**
+   * Milliseconds the background writer sleeps between rounds
+	 */
+  std::uint32_t writerInterval;
+
+	/**
+   * Most pages the background writer writes in one round
+	 */
+  std::uint32_t writerMaxPages;
+
+	/**
+   * Fraction of the pool the background writer lets stay dirty
+	 */
+  double writerDirtyRatio;
+
+	/**
+   * Number of threads reading prefetched pages in. Each prefetch is a plain
+   * read on one of them; queued asynchronous reads such as io_uring would need
+   * liburing, which the build does not link against.
+	 */
+  static const std::uint32_t NUM_PREFETCHERS = 2;
+
+	/**
+   * Prefetch threads, started by the first prefetch request
+	 */
+  std::thread prefetchers[NUM_PREFETCHERS];
+
+	/**
+   * Guards the prefetch queue, prefetchFiles and prefetchStop
+	 */
+  std::mutex prefetchMutex;
+
+	/**
+   * Signalled when a prefetch is queued, and when one is done
+	 */
+  std::condition_variable prefetchWake;
+  std::condition_variable prefetchDone;
+
+	/**
+   * Pages waiting to be prefetched, oldest first. Holds at most numBufs pages.
+	 */
+  std::deque<std::pair<File*, PageId> > prefetchQueue;
+
+	/**
+   * File each prefetch thread is reading a page of, NULL while it is idle
+	 */
+  const File* prefetchFiles[NUM_PREFETCHERS];
+
+	/**
+   * Set to tell the prefetch threads to finish
+	 */
+  bool prefetchStop;
+
+	/**
+	 * Allocate a free frame. The frame is returned claimed and outside the page
+	 * table; the caller either Set()s it or Clear()s it to hand it back.
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param file   	File of the page the frame is for, NULL for a newly allocated page
+	 * @param pageNo  Page number of the page the frame is for
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
-  void allocBuf(FrameId & frame);
+  void allocBuf(FrameId & frame, const File* file, const PageId pageNo);
+
+	/**
+	 * Allocate a free frame, reporting a full buffer pool through the return value.
+	 *
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param file   	File of the page the frame is for, NULL for a newly allocated page
+	 * @param pageNo  Page number of the page the frame is for
+	 * @return  False if no such buffer is found which can be allocated
+	 */
+  bool tryAllocBuf(FrameId & frame, const File* file, const PageId pageNo);
 
 	/**
-   * Advance clock to next frame in the buffer pool
+	 * Allocate a frame for a page read through a ring, recycling the ring's
+	 * oldest frame if it still holds the page the ring put there.
+	 *
+	 * @param ring   	Ring of the reader
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param file   	File of the page the frame is for
+	 * @param pageNo  Page number of the page the frame is for
+	 * @return  False if no such buffer is found which can be allocated
+	 */
+  bool tryAllocRingBuf(BufferRing& ring, FrameId & frame, const File* file, const PageId pageNo);
+
+	/**
+	 * Bring a page into a frame the caller has allocated and publish it in the
+	 * page table. Threads finding the page meanwhile wait until it is read.
+	 *
+	 * @param frameNo   	Frame allocated by the caller
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @param ring  	Ring the frame was allocated through, NULL for the pool proper
+	 * @param pin  	True to return the page pinned, false to leave it for a later readPage()
+	 * @return  False if another thread brought the page in first, in which case the frame has been handed back
+	 */
+  bool installPage(const FrameId frameNo, File* file, const PageId pageNo, const BufferRing* ring, const bool pin);
+
+	/**
+	 * Bring a page in unpinned unless it is in the buffer pool already.
+	 * Failures are ignored, since a later readPage() reports them.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @return  True if the page was read
+	 */
+  bool tryPrefetch(File* file, const PageId pageNo);
+
+	/**
+	 * Body of a prefetch thread
+	 *
+	 * @param slot  	Index of the thread in prefetchers
 	 */
-  void advanceClock()
+  void prefetcher(const std::uint32_t slot);
+
+	/**
+	 * Drop the queued prefetches of a file and wait for those in progress.
+	 *
+	 * @param file   	File object
+	 */
+  void cancelPrefetches(const File* file);
+
+	/**
+	 * Drop a pin on the page held in a frame, without looking the page up.
+	 *
+	 * @param frameNo   	Frame holding the page
+	 * @param dirty		True if the page needs to be marked dirty
+	 * @return  False if the page is not pinned
+	 */
+  bool tryUnPinFrame(const FrameId frameNo, const bool dirty);
+
+	/**
+	 * Write out the dirty pages among frames of one file, merging pages with
+	 * consecutive numbers into a single write, and sync the file if anything
+	 * was written.
+	 *
+	 * @param frames   	Frames the caller has claimed, in page order
+	 */
+  void writeDirtyFrames(const std::vector<FrameId>& frames);
+
+	/**
+	 * Hand back frames claimed by the caller.
+	 *
+	 * @param frames   	Frames the caller has claimed
+	 */
+  void releaseClaims(const std::vector<FrameId>& frames);
+
+	/**
+	 * Write out and unmap the page held in a frame the caller has claimed.
+	 *
+	 * @param frame   	Frame claimed by the caller
+	 * @return  False if the page was pinned or dirtied again meanwhile, so the frame must be left alone
+	 * @throws  InvalidPageException or FileIOException If the page could not be written; the claim is released and the page stays dirty
+	 */
+  bool evictFrame(const FrameId frame);
+
+	/**
+	 * Write out the page held in a frame if it is dirty and nobody has it pinned,
+	 * leaving it in the pool. Writers holding the page latch are not waited for.
+	 *
+	 * @param frame   	Frame to clean
+	 * @return  True if the page was written
+	 */
+  bool cleanFrame(const FrameId frame);
+
+	/**
+	 * One round of the background writer: clean the dirty frames the policy
+	 * will evict next, and further ones while too much of the pool is dirty.
+	 *
+	 * @return  Number of pages written
+	 */
+  std::uint32_t writeBackRound();
+
+	/**
+   * Body of the background writer thread
+	 */
+  void backgroundWriter();
+
+	/**
+	 * Enter a page in the page table and in its file's list of frames.
+	 * The caller holds the partition mutex.
+	 *
+	 * @param partition  	Partition responsible for (file, pageNo)
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo   	Frame holding the page
+	 */
+  void mapFrame(PageTablePartition& partition, const File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+	 * Remove a page from the page table and from its file's list of frames.
+	 * The caller holds the partition mutex.
+	 *
+	 * @param partition  	Partition responsible for (file, pageNo)
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo   	Frame holding the page
+	 */
+  void unmapFrame(PageTablePartition& partition, const File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+   * Return the page table partition responsible for (file, pageNo)
+	 */
+  PageTablePartition& partitionFor(const File* file, const PageId pageNo)
   {
-		clockHand = (clockHand + 1) % numBufs;
+		return partitions[(file->id() * 0x9e3779b1u + pageNo) % NUM_PARTITIONS];
   }
 
 
+
  public:
 	/**
    * Actual buffer pool from which frames are allocated
@@ -211,8 +680,11 @@ class BufMgr
 
 	/**
    * Constructor of BufMgr class
+	 *
+	 * @param bufs   	Number of frames in the buffer pool
+	 * @param replacement	Policy choosing the frames to reuse
 	 */
-  BufMgr(std::uint32_t bufs);
+  BufMgr(std::uint32_t bufs, const Replacement replacement = CLOCK);
 	
 	/**
    * Destructor of BufMgr class
@@ -227,8 +699,50 @@ class BufMgr
 	 * @param file   	File object
 	 * @param PageNo  Page number in the file to be read
 	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param ring  	Ring to read the page through if it is not in the pool, NULL to read it into the pool proper
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page, BufferRing* ring = NULL);
+
+	/**
+	 * Same as readPage(), but reports a full buffer pool through the return value instead of an exception.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer, only set if the page is read
+	 * @param ring  	Ring to read the page through if it is not in the pool, NULL to read it into the pool proper
+	 * @return  False if every frame is pinned, so the page could not be brought in
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  bool tryReadPage(File* file, const PageId PageNo, Page*& page, BufferRing* ring = NULL);
+
+	/**
+	 * Same as readPage(), but returns the page through a handle that unpins it
+	 * by its frame.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param ring  	Ring to read the page through if it is not in the pool, NULL to read it into the pool proper
+	 * @return  Handle holding the pin on the page
+	 */
+  PageHandle readPage(File* file, const PageId PageNo, BufferRing* ring = NULL);
+
+	/**
+	 * Ask for a page to be read into the buffer pool in the background, so that
+	 * a later readPage() finds it there. This is only a hint: it returns at
+	 * once, and the request is dropped if too many are queued already. The
+	 * page is handed to the replacement policy as not yet referenced.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 */
+  void prefetchPage(File* file, const PageId PageNo);
+
+	/**
+	 * Same as prefetchPage(), for several pages, read in the given order.
+	 *
+	 * @param file   	File object
+	 * @param pageNos  Page numbers in the file to be read
+	 */
+  void prefetchPages(File* file, const std::vector<PageId>& pageNos);
 
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
@@ -240,6 +754,38 @@ class BufMgr
 	 */
   void unPinPage(File* file, const PageId PageNo, const bool dirty);
 
+	/**
+	 * Same as unPinPage(), but reports a page that is not pinned through the return value instead of an exception.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+	 * @return  False if the page is not in the buffer pool or not pinned
+	 */
+  bool tryUnPinPage(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * Same as unPinPage(), for a page the caller holds the pointer to, so the
+	 * page table need not be searched.
+	 *
+	 * @param page  	Page pointer returned by readPage() or allocPage()
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+   * @throws  PageNotPinnedException If the page is not already pinned
+	 */
+  void unPinPage(const Page* page, const bool dirty);
+
+	/**
+	 * Same as unPinPage(const Page*, const bool), but reports a page that is not pinned through the return value.
+	 *
+	 * @param page  	Page pointer returned by readPage() or allocPage()
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+	 * @return  False if the page is not pinned
+	 */
+  bool tryUnPinPage(const Page* page, const bool dirty)
+  {
+		return tryUnPinFrame(page - bufPool, dirty);
+  }
+
 	/**
 	 * Allocates a new, empty page in the file and returns the Page object.
 	 * The newly allocated page is also assigned a frame in the buffer pool.
@@ -251,7 +797,17 @@ class BufMgr
   void allocPage(File* file, PageId &PageNo, Page*& page); 
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
+	 * Same as allocPage(), but returns the page through a handle that unpins it
+	 * by its frame. The handle is marked dirty, since the new page has yet to be written.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @return  Handle holding the pin on the new page
+	 */
+  PageHandle allocPage(File* file, PageId &PageNo);
+
+	/**
+	 * Writes out all dirty pages of the file to disk and syncs the file.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
 	 * Otherwise Error returned.
 	 *
@@ -271,6 +827,51 @@ class BufMgr
   void disposePage(File* file, const PageId PageNo);
 
 	/**
+	 * Latch the contents of a page that the caller has pinned.
+	 * Shared latches exclude writers only; an exclusive latch excludes everybody.
+	 *
+	 * @param page  	Page pointer returned by readPage() or allocPage()
+	 * @param exclusive	True to latch for writing, false to latch for reading
+	 */
+  void latchPage(const Page* page, const bool exclusive)
+  {
+		RWLatch& latch = bufDescTable[page - bufPool].latch;
+		if (exclusive)
+			latch.lockExclusive();
+		else
+			latch.lockShared();
+  }
+
+	/**
+	 * Release the latch taken on a page by latchPage(). The page must still be pinned.
+	 *
+	 * @param page  	Page pointer returned by readPage() or allocPage()
+	 */
+  void unlatchPage(const Page* page)
+  {
+		bufDescTable[page - bufPool].latch.unlock();
+  }
+
+	/**
+	 * Start a thread that writes dirty, unpinned pages back ahead of the
+	 * replacement policy, so that allocating a frame seldom has to write one.
+	 * Each round it cleans the dirty pages among the next maxPagesPerRound
+	 * victims, then keeps going down the victim order while more than
+	 * dirtyRatio of the pool is dirty, writing at most maxPagesPerRound pages.
+	 * A writer already running is stopped first.
+	 *
+	 * @param intervalMs  	Milliseconds to sleep between rounds
+	 * @param maxPagesPerRound	Most pages to write in one round
+	 * @param dirtyRatio  	Fraction of the pool allowed to stay dirty, between 0 and 1
+	 */
+  void startBackgroundWriter(const std::uint32_t intervalMs, const std::uint32_t maxPagesPerRound, const double dirtyRatio);
+
+	/**
+	 * Stop the background writer and wait for it to finish its round, if one is running.
+	 */
+  void stopBackgroundWriter();
+
+	/**
    * Print member variable values. 
 	 */
   void  printSelf();
@@ -283,6 +884,14 @@ class BufMgr
 		return bufStats;
   }
 
+	/**
+   * Get the name of the replacement policy in use
+	 */
+  const char* getPolicyName() const
+  {
+		return policy->name();
+  }
+
 	/**
    * Clear buffer pool usage statistics
 	 */
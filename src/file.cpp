@@ -7,11 +7,13 @@
 
 #include "file.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 
 #include "exceptions/file_exists_exception.h"
@@ -23,8 +25,11 @@
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
+File::OpenFileMap File::open_files_;
 File::CountMap File::open_counts_;
+std::mutex File::open_mutex_;
+std::atomic<IoBackend> File::default_backend_(STREAM_IO);
+std::atomic<std::uint32_t> File::next_id_(0);
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -40,6 +45,7 @@ bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
+  std::lock_guard<std::mutex> guard(open_mutex_);
   return open_counts_.find(filename) != open_counts_.end();
 }
 
@@ -54,8 +60,20 @@ bool File::exists(const std::string& filename) {
 	return false;
 }
 
+void File::setDefaultBackend(const IoBackend backend) {
+  default_backend_ = backend;
+}
+
+IoBackend File::defaultBackend() {
+  return default_backend_;
+}
+
 File::~File() {
-  close();
+  try {
+    close();
+  } catch (...) {
+    // a destructor must not throw; call sync() first to see write errors
+  }
 }
 
 
@@ -64,7 +82,17 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
+void File::sync() const {
+  flushHeader(*open_file_);
+  storage_->sync();
+}
+
+void File::advise(const AccessHint hint) const {
+  storage_->advise(hint);
+}
+
+File::File(const std::string& name, const bool create_new)
+  : filename_(name), id_(next_id_++) {
   openIfNeeded(create_new);
 
   if (create_new) {
@@ -76,56 +104,80 @@ File::File(const std::string& name, const bool create_new) : filename_(name) {
 }
 
 void File::openIfNeeded(const bool create_new) {
+  std::lock_guard<std::mutex> guard(open_mutex_);
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+    open_file_ = open_files_[filename_];
+    storage_ = open_file_->storage.get();
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
     const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
       if (already_exists) {
         throw FileExistsException(filename_);
       }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
+    std::shared_ptr<OpenFile> open_file(new OpenFile);
+    open_file->storage.reset(Storage::open(filename_, default_backend_, create_new));
+    // the header is read once here and kept in memory from now on
+    open_file->storage->read(0 /* pos */,
+                             reinterpret_cast<char*>(&open_file->header),
+                             sizeof(FileHeader));
+    open_file->header_dirty = false;
+    // a new file has no used pages to find
+    open_file->used_pages_loaded = create_new;
+    open_file_ = open_file;
+    storage_ = open_file_->storage.get();
+    open_files_[filename_] = open_file_;
     open_counts_[filename_] = 1;
   }
 }
 
 void File::close() {
+  std::lock_guard<std::mutex> guard(open_mutex_);
 	if(open_counts_[filename_] > 0)
   	--open_counts_[filename_];
 
-  stream_.reset();
+  std::shared_ptr<OpenFile> open_file = open_file_;
+  open_file_.reset();
+  storage_ = NULL;
 	assert(open_counts_[filename_] >= 0);
 
   if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
+    open_files_.erase(filename_);
     open_counts_.erase(filename_);
+    // still under open_mutex_, so that nobody reopens the file and reads the
+    // old header from disk first
+    if (open_file) {
+      flushHeader(*open_file);
+    }
   }
 }
 
 FileHeader File::readHeader() const {
-  FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
-  return header;
+  std::lock_guard<std::mutex> guard(open_file_->header_mutex);
+  return open_file_->header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+  std::lock_guard<std::mutex> guard(open_file_->header_mutex);
+  open_file_->header = header;
+  open_file_->header_dirty = true;
+}
+
+void File::flushHeader(OpenFile& open_file) {
+  std::lock_guard<std::mutex> guard(open_file.header_mutex);
+  if (open_file.header_dirty) {
+    open_file.storage->write(0 /* pos */,
+                             reinterpret_cast<const char*>(&open_file.header),
+                             sizeof(FileHeader));
+    open_file.header_dirty = false;
+  }
 }
 
 
@@ -163,101 +215,86 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
+  allocatePageInto(new_page_number, &new_page);
+  return new_page;
+}
+
+void PageFile::allocatePageInto(PageId &new_page_number, Page* new_page) {
+  std::lock_guard<std::mutex> guard(open_file_->meta_mutex);
+  FileHeader header = readHeader();
+  // the used page the new one follows on the used list
+  PageId previous_page_number;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-		new_page_number = new_page.page_number();
-    header.first_free_page = new_page.next_page_number();
+    // Free pages are cleared when deleted, so only the free list link is read.
+    new_page_number = header.first_free_page;
+    header.first_free_page = readPageHeader(new_page_number).next_page_number;
     --header.num_free_pages;
+    new_page->initialize();
+    new_page->set_page_number(new_page_number);
 
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
-    }
+    // The reused page may lie anywhere among the used pages.
+    loadUsedPages();
+    previous_page_number = previousUsedPage(new_page_number);
 
     assert((header.num_free_pages == 0) ==
            (header.first_free_page == Page::INVALID_NUMBER));
   }
 	else
 	{
-    new_page.set_page_number(header.num_pages);
-		new_page_number = new_page.page_number();
-
-    if (header.first_used_page == Page::INVALID_NUMBER)
-		{
-      header.first_used_page = new_page.page_number();
-    }
-		else
-		{
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
-    }
+    new_page->initialize();
+    new_page->set_page_number(header.num_pages);
+		new_page_number = new_page->page_number();
     ++header.num_pages;
+
+    // A page at the end of the file goes at the tail of the used list.  With
+    // no free pages every other page is used, so the tail is the page before.
+    previous_page_number = new_page_number - 1;
   }
-  writePage(new_page_number, new_page.header_, new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page.header_, existing_page);
+
+  if (previous_page_number == Page::INVALID_NUMBER) {
+    new_page->set_next_page_number(header.first_used_page);
+    header.first_used_page = new_page_number;
+  } else {
+    // Only the header of the page linking to the new one is rewritten.
+    PageHeader previous_header = readPageHeader(previous_page_number);
+    new_page->set_next_page_number(previous_header.next_page_number);
+    previous_header.next_page_number = new_page_number;
+    writePageHeader(previous_page_number, previous_header);
   }
-  writeHeader(header);
+  markUsed(new_page_number, true);
 
-  return new_page;
+  writePage(new_page_number, new_page->header_, *new_page);
+  writeHeader(header);
 }
 
 Page PageFile::readPage(const PageId page_number) const {
+  Page page;
+  readPageInto(page_number, &page);
+  return page;
+}
+
+void PageFile::readPageInto(const PageId page_number, Page* page) const {
   FileHeader header = readHeader();
 
 	if (page_number >= header.num_pages)
 	{
 		throw InvalidPageException(page_number, filename_);
 	}
-	return readPage(page_number, false /* allow_free */);
+	readPageInto(page_number, page, false /* allow_free */);
 }
 
-Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
-  Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
-  if (!allow_free && !page.isUsed()) {
+void PageFile::readPageInto(const PageId page_number, Page* page,
+                            const bool allow_free) const {
+  storage_->read(pagePosition(page_number), reinterpret_cast<char*>(page),
+                 Page::SIZE);
+  if (!allow_free && !page->isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-
-  return page;
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
+	std::lock_guard<std::mutex> guard(open_file_->meta_mutex);
 	PageHeader header = readPageHeader(new_page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
 	{
@@ -273,33 +310,61 @@ void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 	writePage(new_page_number, header, new_page);
 }
 
+void PageFile::writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) {
+  // keep the next page pointers on disk as writePage() does, and check every
+  // page before anything is written
+  std::lock_guard<std::mutex> guard(open_file_->meta_mutex);
+  std::vector<PageHeader> headers(pages.size());
+  std::vector<IoBuffer> buffers;
+  buffers.reserve(2 * pages.size());
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    PageHeader& header = headers[i];
+    header = readPageHeader(first_page_number + i);
+    if (header.current_page_number == Page::INVALID_NUMBER) {
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+    const PageId next_page_number = header.next_page_number;
+    header = pages[i]->header_;
+    header.next_page_number = next_page_number;
+    buffers.push_back(IoBuffer(reinterpret_cast<const char*>(&header),
+                               sizeof(PageHeader)));
+    buffers.push_back(IoBuffer(&pages[i]->data_[0],
+                               static_cast<std::size_t>(Page::DATA_SIZE)));
+  }
+  storage_->writev(pagePosition(first_page_number), buffers);
+}
+
 void PageFile::deletePage(const PageId page_number) {
+  std::lock_guard<std::mutex> guard(open_file_->meta_mutex);
   FileHeader header = readHeader();
 
-  Page existing_page = readPage(page_number);
-  Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
-    header.first_used_page = existing_page.next_page_number();
+	if (page_number >= header.num_pages)
+	{
+		throw InvalidPageException(page_number, filename_);
+	}
+  const PageHeader existing_header = readPageHeader(page_number);
+  if (existing_header.current_page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  // Unlink the page from the used list, through the header if it is the head
+  // and through the used page before it otherwise.
+  loadUsedPages();
+  const PageId previous_page_number = previousUsedPage(page_number);
+  if (previous_page_number == Page::INVALID_NUMBER) {
+    header.first_used_page = existing_header.next_page_number;
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    PageHeader previous_header = readPageHeader(previous_page_number);
+    previous_header.next_page_number = existing_header.next_page_number;
+    writePageHeader(previous_page_number, previous_header);
   }
+  markUsed(page_number, false);
+
   // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
+  Page existing_page;
   existing_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
   ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page.header_, previous_page);
-  }
   writePage(page_number, existing_page.header_, existing_page);
   writeHeader(header);
 }
@@ -315,17 +380,77 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  char buffer[Page::SIZE];
+  std::memcpy(buffer, &header, sizeof(PageHeader));
+  std::memcpy(buffer + sizeof(PageHeader), &new_page.data_[0], Page::DATA_SIZE);
+  storage_->write(pagePosition(page_number), buffer, Page::SIZE);
+}
+
+void PageFile::writePageHeader(const PageId page_number,
+                               const PageHeader& header) {
+  storage_->write(pagePosition(page_number),
+                  reinterpret_cast<const char*>(&header), sizeof(PageHeader));
+}
+
+void PageFile::loadUsedPages() {
+  OpenFile& open_file = *open_file_;
+  if (open_file.used_pages_loaded) {
+    return;
+  }
+  open_file.used_pages.clear();
+  open_file.used_pages_loaded = true;
+  const FileHeader header = readHeader();
+  for (PageId page_number = header.first_used_page;
+       page_number != Page::INVALID_NUMBER;
+       page_number = readPageHeader(page_number).next_page_number) {
+    markUsed(page_number, true);
+  }
+}
+
+void PageFile::markUsed(const PageId page_number, const bool used) {
+  OpenFile& open_file = *open_file_;
+  if (!open_file.used_pages_loaded) {
+    return;
+  }
+  const std::size_t word = page_number / 64;
+  const std::uint64_t bit = std::uint64_t(1) << (page_number % 64);
+  if (word >= open_file.used_pages.size()) {
+    if (!used) {
+      return;
+    }
+    // grow by doubling, as pages are appended one at a time
+    open_file.used_pages.resize(std::max(word + 1, open_file.used_pages.size() * 2));
+  }
+  if (used) {
+    open_file.used_pages[word] |= bit;
+  } else {
+    open_file.used_pages[word] &= ~bit;
+  }
+}
+
+PageId PageFile::previousUsedPage(const PageId page_number) const {
+  const std::vector<std::uint64_t>& used_pages = open_file_->used_pages;
+  std::size_t word = page_number / 64;
+  // bits of the page's own word below the page
+  std::uint64_t bits = 0;
+  if (word < used_pages.size()) {
+    bits = used_pages[word] & ((std::uint64_t(1) << (page_number % 64)) - 1);
+  } else {
+    word = used_pages.size();
+  }
+  while (bits == 0) {
+    if (word == 0) {
+      return Page::INVALID_NUMBER;
+    }
+    bits = used_pages[--word];
+  }
+  return word * 64 + (63 - __builtin_clzll(bits));
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  storage_->read(pagePosition(page_number), reinterpret_cast<char*>(&header),
+                 sizeof(PageHeader));
   return header;
 }
 
@@ -362,39 +487,81 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
 }
 
 Page BlobFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
 	Page new_page;
+	allocatePageInto(new_page_number, &new_page);
+	return new_page;
+}
 
-	new_page_number = header.num_pages;
+void BlobFile::allocatePageInto(PageId &new_page_number, Page* new_page) {
+  std::lock_guard<std::mutex> guard(open_file_->meta_mutex);
+  FileHeader header = readHeader();
 
-	if (header.first_used_page == Page::INVALID_NUMBER) {
-		header.first_used_page = header.num_pages;
+	if (header.num_free_pages > 0) {
+		// Reuse the page at the head of the free list; only its link is needed.
+		new_page_number = header.first_free_page;
+		storage_->read(pagePosition(new_page_number),
+		               reinterpret_cast<char*>(&header.first_free_page),
+		               sizeof(PageId));
+		--header.num_free_pages;
 	}
+	else
+	{
+		new_page_number = header.num_pages;
 
-	++header.num_pages;
+		if (header.first_used_page == Page::INVALID_NUMBER) {
+			header.first_used_page = header.num_pages;
+		}
 
-	writePage(new_page_number, new_page);
-	writeHeader(header);
+		++header.num_pages;
+	}
 
-	return new_page;
+	new_page->initialize();
+	writePage(new_page_number, *new_page);
+	writeHeader(header);
 }
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readPageInto(page_number, &page);
 	return page;
 }
 
+void BlobFile::readPageInto(const PageId page_number, Page* page) const {
+	storage_->read(pagePosition(page_number), reinterpret_cast<char*>(page),
+	               Page::SIZE);
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	storage_->write(pagePosition(new_page_number),
+	                reinterpret_cast<const char*>(&new_page), Page::SIZE);
+}
+
+void BlobFile::writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) {
+	std::vector<IoBuffer> buffers;
+	for (std::size_t i = 0; i < pages.size(); ++i) {
+		buffers.push_back(IoBuffer(reinterpret_cast<const char*>(pages[i]),
+		                           static_cast<std::size_t>(Page::SIZE)));
+	}
+	storage_->writev(pagePosition(first_page_number), buffers);
 }
 
-//delePage should not be called for a blob_file, not supported
 void BlobFile::deletePage(const PageId page_number) {
-	throw InvalidPageException(page_number, filename_);
+  std::lock_guard<std::mutex> guard(open_file_->meta_mutex);
+  FileHeader header = readHeader();
+	if (page_number == Page::INVALID_NUMBER || page_number >= header.num_pages) {
+		throw InvalidPageException(page_number, filename_);
+	}
+	// Blob pages have no header, so free pages are chained through the page
+	// number stored at the start of each one.
+	Page free_page;
+	memset(reinterpret_cast<char*>(&free_page), 0, Page::SIZE);
+	*reinterpret_cast<PageId*>(&free_page) = header.first_free_page;
+	header.first_free_page = page_number;
+	++header.num_free_pages;
+
+	writePage(page_number, free_page);
+	writeHeader(header);
 }
 
 }
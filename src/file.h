@@ -7,12 +7,16 @@
 
 #pragma once
 
+#include <atomic>
 #include <fstream>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "page.h"
+#include "storage.h"
 
 namespace badgerdb {
 
@@ -56,19 +60,80 @@ struct FileHeader {
   }
 };
 
+// Every page is found at an offset past the header, so a file written with a
+// header of another size cannot be read.
+static_assert(sizeof(FileHeader) == 16,
+              "FileHeader size fixes the page offsets of existing files");
+
+/**
+ * @brief State shared by all File objects open on the same file: the storage
+ *        and a cached copy of the file header.
+ *
+ * The header is only read from disk when the file is opened.  Changes to it
+ * are kept in memory and written back by File::sync() or when the last File
+ * object on the file closes.
+ */
+struct OpenFile {
+  /**
+   * Storage for the file.
+   */
+  std::unique_ptr<Storage> storage;
+
+  /**
+   * Current header of the file.
+   */
+  FileHeader header;
+
+  /**
+   * Whether the header has changed since it was last written to disk.
+   */
+  bool header_dirty;
+
+  /**
+   * Guards header and header_dirty.
+   */
+  std::mutex header_mutex;
+
+  /**
+   * One bit per page of a PageFile, set for the pages on the used list, so
+   * that the used page before any page is found without reading the list.
+   * It is not stored; it is built from the used list the first time a page
+   * is deleted or reused.  Guarded by meta_mutex.
+   */
+  std::vector<std::uint64_t> used_pages;
+
+  /**
+   * Whether used_pages has been built.  Guarded by meta_mutex.
+   */
+  bool used_pages_loaded;
+
+  /**
+   * Held by File objects while they update the file header and page links,
+   * so that allocations and deletions on the file do not interleave.
+   */
+  std::mutex meta_mutex;
+};
+
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
+ * The File class wraps a Storage for an underlying file on disk.  Files contain
  * fixed-sized pages, and they never deallocate space (though they do reuse
  * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * underlying file, they will share the storage and file header in memory.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the open_files_ map) and just returns a file object with
+ * the already created storage for the file without actually opening the UNIX file again,
+ * whichever backend was asked for.
  *
- * @warning This class is not threadsafe.
+ * Pages may be read and written from several threads at once, and allocations
+ * and deletions are serialized per file.  A single File object must still not
+ * be reassigned while other threads use it.  The file header is written back
+ * by sync() and on the last close, and with the POSIX_IO backend writes are
+ * only known to be on disk after sync().  The MMAP_IO backend suits
+ * read-mostly files such as indexes, whose pages are then copied straight out
+ * of the page cache.
  */
 
 
@@ -111,6 +176,19 @@ class File {
    */
   static bool exists(const std::string& filename);
 
+  /**
+   * Sets the backend files opened from now on are accessed with.  Files
+   * already open keep theirs.  The default is STREAM_IO.
+   *
+   * @param backend   Backend for newly opened files.
+   */
+  static void setDefaultBackend(const IoBackend backend);
+
+  /**
+   * Returns the backend newly opened files are accessed with.
+   */
+  static IoBackend defaultBackend();
+
   /**
    * Destructor that automatically closes the underlying file if no other
    * File objects are using it.
@@ -124,6 +202,15 @@ class File {
    */
   virtual Page allocatePage(PageId &new_page_number) = 0;
 
+  /**
+   * Allocates a new page in the file and sets up its contents in the given
+   * page, such as a buffer frame, instead of returning a copy.
+   *
+   * @param new_page_number   Number of the new page returned via this variable.
+   * @param new_page          Page the contents of the new page are placed in.
+   */
+  virtual void allocatePageInto(PageId &new_page_number, Page* new_page) = 0;
+
   /**
    * Reads an existing page from the file.
    *
@@ -134,6 +221,17 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads an existing page from the file straight into the given page, such
+   * as a buffer frame, instead of returning a copy.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page the contents are read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void readPageInto(const PageId page_number, Page* page) const = 0;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -143,6 +241,17 @@ class File {
    */
   virtual void writePage(const PageId page_number, const Page& new_page) = 0;
 
+  /**
+   * Writes pages with consecutive page numbers into the file with a single
+   * gathered write, the way writePage() writes each of them.
+   * No bounds checking is performed.
+   *
+   * @param first_page_number Number of the first page whose contents to replace.
+   * @param pages             Pages to write, in page number order.
+   */
+  virtual void writePages(const PageId first_page_number,
+                          const std::vector<const Page*>& pages) = 0;
+
   /**
    * Deletes a page from the file.
    *
@@ -157,6 +266,34 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns a number identifying this File object, unique among all File
+   * objects created by this process and fixed for the object's lifetime.
+   *
+   * @return Id of this file object.
+   */
+  std::uint32_t id() const { return id_; }
+
+  /**
+   * Returns the backend the underlying file is accessed with.
+   */
+  IoBackend backend() const { return storage_->backend(); }
+
+  /**
+   * Writes back the file header if it has changed, and makes all pages and
+   * headers written to the file so far durable.
+   *
+   * @throws  FileIOException  If the sync fails.
+   */
+  void sync() const;
+
+  /**
+   * Tells the operating system how the file is about to be read.
+   *
+   * @param hint  Expected access pattern.
+   */
+  void advise(const AccessHint hint) const;
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -179,7 +316,7 @@ class File {
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing storage.
    *
    * @param create_new  Whether to create a new file.
    * @throws  FileExistsException     If the underlying file exists and
@@ -190,48 +327,81 @@ class File {
   void openIfNeeded(const bool create_new);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Releases the shared state in <open_file_>.
    * This method only closes the file if no other File objects exist that access
-   * the same file.
+   * the same file, writing back its header if it has changed.
    */
   void close();
 
   /**
-   * Reads the header for this file from disk.
+   * Returns the cached header for this file.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Replaces the cached header for this file.  It reaches the disk on sync()
+   * or when the file is closed.
    *
    * @param header  File header to write.
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
+  /**
+   * Writes the cached header of a file to disk if it has changed.
+   *
+   * @param open_file   Shared state of the file.
+   */
+  static void flushHeader(OpenFile& open_file);
+
+  typedef std::map<std::string, std::shared_ptr<OpenFile> > OpenFileMap;
   typedef std::map<std::string, int> CountMap;
 
   /**
-   * Streams for opened files.
+   * Shared state of opened files.
    */
-  static StreamMap open_streams_;
+  static OpenFileMap open_files_;
 
   /**
    * Counts for opened files.
    */
   static CountMap open_counts_;
 
+  /**
+   * Guards open_files_ and open_counts_.
+   */
+  static std::mutex open_mutex_;
+
+  /**
+   * Backend newly opened files are accessed with.
+   */
+  static std::atomic<IoBackend> default_backend_;
+
+  /**
+   * Id handed to the next File object constructed.
+   */
+  static std::atomic<std::uint32_t> next_id_;
+
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Id of this file object, see id().
+   */
+  std::uint32_t id_;
+
+  /**
+   * Shared state of the underlying filesystem object.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<OpenFile> open_file_;
+
+  /**
+   * Storage of open_file_, kept at hand.
+   */
+  Storage* storage_;
 
   friend class FileIterator;
 };
@@ -249,10 +419,10 @@ class PageFile : public File {
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same storage to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the storage associated with this File object are inserted into the
+	 * open_files_ map.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -300,6 +470,17 @@ class PageFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file into the given page.  A page added at
+   * the end of the file is linked after the page before it, which is the last
+   * used page, without walking the used list.  A deleted page that is reused
+   * is linked after the used page before it, which is looked up in the bitmap
+   * of used pages.
+   *
+   * @see File::allocatePageInto()
+   */
+  void allocatePageInto(PageId &new_page_number, Page* new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -310,6 +491,13 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file into the given page.
+   *
+   * @see File::readPageInto()
+   */
+  void readPageInto(const PageId page_number, Page* page) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -320,7 +508,22 @@ class PageFile : public File {
   void writePage(const PageId page_number, const Page& new_page);
 
   /**
-   * Deletes a page from the file.
+   * Writes pages with consecutive page numbers into the file with a single
+   * gathered write, the way writePage() writes each of them.
+   * No bounds checking is performed.
+   *
+   * @param first_page_number Number of the first page whose contents to replace.
+   * @param pages             Pages to write, in page number order.
+   * @throws  InvalidPageException  If any of the pages has been deleted, in
+   *                                which case none is written.
+   */
+  void writePages(const PageId first_page_number,
+                  const std::vector<const Page*>& pages);
+
+  /**
+   * Deletes a page from the file.  The used page linking to it is looked up
+   * in the bitmap of used pages, which is built by walking the used list
+   * once after the file is opened, and then searched 64 pages at a time.
    *
    * @param page_number   Number of page to delete.
    */
@@ -344,19 +547,21 @@ class PageFile : public File {
  private:
 
   /**
-   * Reads a page from the file.  If <allow_free> is not set, an exception
-   * will be thrown if the page read from disk is not currently in use.
+   * Reads a page from the file into the given page.  If <allow_free> is not
+   * set, an exception will be thrown if the page read from disk is not
+   * currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as zeroes.
    *
    * @param page_number   Number of page to read.
+   * @param page          Page the contents are read into.
    * @param allow_free    Whether to allow reading a free (unused) page.
-   * @return  The page.
    * @throws  InvalidPageException  If the page is free (unused) and
    *                                allow_free is false.
    */
-  Page readPage(const PageId page_number, const bool allow_free) const;
+  void readPageInto(const PageId page_number, Page* page,
+                    const bool allow_free) const;
 
   /**
    * Writes a page into the file at the given page number with the given header.
@@ -379,6 +584,41 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Writes only the header of the given page to disk, leaving the record
+   * data and slot table as they are.  No bounds checking is performed.
+   *
+   * @param page_number   Number of page whose header is to be written.
+   * @param header        Header to write.
+   */
+  void writePageHeader(const PageId page_number, const PageHeader& header);
+
+  /**
+   * Builds the bitmap of used pages from the used list, unless it has been
+   * built already.  The caller holds the file's meta_mutex.
+   */
+  void loadUsedPages();
+
+  /**
+   * Sets or clears the bit of a page in the bitmap of used pages, if it has
+   * been built.  The caller holds the file's meta_mutex.
+   *
+   * @param page_number   Number of page.
+   * @param used          Whether the page is on the used list.
+   */
+  void markUsed(const PageId page_number, const bool used);
+
+  /**
+   * Returns the used page with the highest number below the given one, which
+   * is the page linking to it on the used list.  The bitmap of used pages
+   * must have been built.
+   *
+   * @param page_number   Number of page.
+   * @return  Number of the previous used page, or Page::INVALID_NUMBER if
+   *          there is none.
+   */
+  PageId previousUsedPage(const PageId page_number) const;
+
   friend class FileIterator;
 };
 
@@ -395,10 +635,10 @@ class BlobFile : public File {
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same storage to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the storage associated with this File object are inserted into the
+	 * open_files_ map.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -442,12 +682,19 @@ class BlobFile : public File {
   ~BlobFile();
 
   /**
-   * Allocates a new page in the file.
+   * Allocates a new page in the file, reusing a deleted page if there is one.
    *
    * @return The new page.
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file into the given page.
+   *
+   * @see File::allocatePageInto()
+   */
+  void allocatePageInto(PageId &new_page_number, Page* new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -458,6 +705,13 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file into the given page.
+   *
+   * @see File::readPageInto()
+   */
+  void readPageInto(const PageId page_number, Page* page) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -468,9 +722,22 @@ class BlobFile : public File {
   void writePage(const PageId page_number, const Page& new_page);
 
   /**
-   * Deletes a page from the file.
+   * Writes pages with consecutive page numbers into the file with a single
+   * gathered write.
+   * No bounds checking is performed.
+   *
+   * @param first_page_number Number of the first page whose contents to replace.
+   * @param pages             Pages to write, in page number order.
+   */
+  void writePages(const PageId first_page_number,
+                  const std::vector<const Page*>& pages);
+
+  /**
+   * Deletes a page from the file. The page is kept on a free list and handed
+   * out again by allocatePage().
    *
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page doesn't exist in the file.
    */
   void deletePage(const PageId page_number);
 };
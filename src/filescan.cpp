@@ -10,25 +10,18 @@
 
 namespace badgerdb { 
 
-FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
+FileScan::FileScan(const std::string &name, BufMgr *bufferMgr, const bool bulkRead)
+  : bulkRead(bulkRead)
 {
   file = new PageFile(name, false);	//dont create new file
 	bufMgr = bufferMgr;
-	curDirtyFlag = false;
-  curPage = NULL;
-	filePageIter = file->begin();
+	curPageNo = file->getFirstPageNo();
 }
 
 FileScan::~FileScan()
 {
   // generally must unpin last page of the scan
-  if (curPage != NULL)
-  {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-		curDirtyFlag = false;
-    filePageIter = file->begin();
-  }
+  curPage.release();
   bufMgr->flushFile(file);
   delete file;
 }
@@ -37,24 +30,16 @@ void FileScan::scanNext(RecordId& outRid)
 {
   std::string rec;
 
-  if (filePageIter == file->end())
+  if (curPageNo == Page::INVALID_NUMBER)
 	{
 		throw EndOfFileException();
 	}
 
   // special case of the first record of the first page of the file
-  if (curPage == NULL)
+  if (!curPage)
   {
-    // need to get the first page of the file
-		filePageIter = file->begin();
-    if(filePageIter == file->end())
-		{
-			throw EndOfFileException();
-		}
-	 
 		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
-		curDirtyFlag = false;
+    readCurPage();
 
 		// get the first record off the page
     pageRecordIter = curPage->begin(); 
@@ -75,20 +60,19 @@ void FileScan::scanNext(RecordId& outRid)
 
   while (pageRecordIter == curPage->end())
   {
-    // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-    curDirtyFlag = false;
+    // unpin the current page; the scan has its own file object, so the page
+    // was read from disk by this scan and its next page number is current
+    PageId nextPageNo = curPage->next_page_number();
+    curPage.release();
 
-    filePageIter++;
-    if (filePageIter == file->end())
+    curPageNo = nextPageNo;
+    if (curPageNo == Page::INVALID_NUMBER)
     {
-      curPage = NULL;
 			throw EndOfFileException();
     }
 
     // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+    readCurPage();
 
     // get the first record off the page
     pageRecordIter = curPage->begin(); 
@@ -104,6 +88,15 @@ void FileScan::scanNext(RecordId& outRid)
 	return;
 }
 
+// read the current page and prefetch the one after it. The file is only
+// read through the buffer manager, whose prefetch threads share its stream.
+void FileScan::readCurPage()
+{
+  curPage = bufMgr->readPage(file, curPageNo, bulkRead ? &ring : NULL);
+  if (curPage->next_page_number() != Page::INVALID_NUMBER)
+    bufMgr->prefetchPage(file, curPage->next_page_number());
+}
+
 // returns pointer to the current record.  page is left pinned
 // and the scan logic is required to unpin the page 
 std::string FileScan::getRecord()
@@ -114,7 +107,7 @@ std::string FileScan::getRecord()
 // mark current page of scan dirty
 void FileScan::markDirty()
 {
-  curDirtyFlag = true;
+  curPage.markDirty();
 }
 
 }
@@ -24,7 +24,15 @@ class FileScan
 {
  public:
 
-  FileScan(const std::string &name, BufMgr *bufMgr);
+  /**
+   * Open a scan over a relation.
+   *
+   * @param name      Name of the relation file
+   * @param bufMgr    Buffer manager to read pages through
+   * @param bulkRead  True to read pages through a small BufferRing, so that a
+   *                  scan over a large relation does not evict the pool's working set
+   */
+  FileScan(const std::string &name, BufMgr *bufMgr, const bool bulkRead = false);
 
   ~FileScan();
 
@@ -49,17 +57,32 @@ class FileScan
 	BufMgr				*bufMgr;
 
   /**
-   * Current page being scanned.
+   * Current page being scanned, marked dirty through markDirty().
+   */
+  PageHandle    curPage;
+
+  /**
+   * Number of the page being scanned, or to be scanned first if curPage holds none.
+   * Page::INVALID_NUMBER once the scan is past the last page.
    */
-  Page*         curPage;
+  PageId        curPageNo;
 
-  FileIterator  filePageIter;
   PageIterator  pageRecordIter;
 
   /**
-   * True if page has been updated
+   * Ring the scan reads pages through if it is a bulk read
+   */
+  BufferRing    ring;
+
+  /**
+   * True if pages are read through ring
+   */
+  bool          bulkRead;
+
+  /**
+   * Read and pin curPageNo, and have the page after it prefetched
    */
-  bool  	      curDirtyFlag;
+  void readCurPage();
 };
 
 }
@@ -0,0 +1,76 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <pthread.h>
+
+namespace badgerdb {
+
+/**
+ * @brief Reader/writer latch guarding an in-memory structure such as a buffer frame.
+ *
+ * Any number of threads may hold the latch shared at the same time, or one
+ * thread may hold it exclusive. Latches are short term and are not reentrant.
+ */
+class RWLatch {
+ public:
+  /**
+   * Constructs an unlatched latch.
+   */
+  RWLatch() {
+    pthread_rwlock_init(&lock_, NULL);
+  }
+
+  /**
+   * Destructor. The latch must not be held.
+   */
+  ~RWLatch() {
+    pthread_rwlock_destroy(&lock_);
+  }
+
+  /**
+   * Blocks until the latch is held shared.
+   */
+  void lockShared() {
+    pthread_rwlock_rdlock(&lock_);
+  }
+
+  /**
+   * Takes the latch shared if that is possible without blocking.
+   *
+   * @return  True if the latch is now held shared.
+   */
+  bool tryLockShared() {
+    return pthread_rwlock_tryrdlock(&lock_) == 0;
+  }
+
+  /**
+   * Blocks until the latch is held exclusive.
+   */
+  void lockExclusive() {
+    pthread_rwlock_wrlock(&lock_);
+  }
+
+  /**
+   * Releases the latch, in whichever mode it is held.
+   */
+  void unlock() {
+    pthread_rwlock_unlock(&lock_);
+  }
+
+ private:
+  RWLatch(const RWLatch&);
+  RWLatch& operator=(const RWLatch&);
+
+  /**
+   * Underlying POSIX reader/writer lock.
+   */
+  pthread_rwlock_t lock_;
+};
+
+}
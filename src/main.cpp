@@ -6,6 +6,10 @@
  */
 
 #include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <fstream>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
@@ -19,6 +23,8 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/invalid_page_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -75,6 +81,41 @@ void test1();
 void test2();
 void test3();
 void test4();
+void test5();
+void insertTests();
+void sparseTests();
+void test6();
+void concurrentTests();
+void test7();
+void cursorTests();
+void test8();
+void batchTests();
+int intScanBatch(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, size_t batchSize);
+void test9();
+void deleteTests();
+void duplicateDeleteTests();
+void test10();
+void doubleTests();
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp, double highVal, Operator highOp);
+void test11();
+void stringTests();
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+void test12();
+void lookupTests();
+void test13();
+void bufferTests();
+void concurrentBufferTests();
+void replacementTests();
+void ringTests();
+void backgroundWriterTests();
+void prefetchTests();
+void pageHandleTests();
+void flushFileTests();
+void fileBackendTests();
+void readIntoTests();
+void headerCacheTests();
+void allocationTests();
+int usedPagesInOrder(PageFile &file);
 void myTest1();
 void myTest2();
 void myTest3();
@@ -152,6 +193,15 @@ int main(int argc, char **argv)
 //	myTest3();
 //	myTest4();
 	test1();
+	test5();
+	test6();
+	test7();
+	test8();
+	test9();
+	test10();
+	test11();
+	test12();
+	test13();
 //	test2();
 //	test3();
 //	errorTests();
@@ -370,6 +420,1633 @@ void intTests2() {
     BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple, i), INTEGER);
 }
 
+/**
+ * Bulk load a fully packed index, then insert a second copy of every entry with
+ * its key shifted by relationSize. Every leaf has to split on the way.
+ */
+void test5()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "createRelationForward" << std::endl;
+	createRelationForward();
+	insertTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	sparseTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	deleteRelation();
+}
+
+void insertTests()
+{
+	std::cout << "Create a packed B+ Tree index on the integer field and insert into it" << std::endl;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 1.0);
+
+	{
+		FileScan fscan(relationName, bufMgr);
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				std::string recordStr = fscan.getRecord();
+				int key = *((int *)(recordStr.c_str() + offsetof(RECORD, i))) + relationSize;
+				index.insertEntry(&key, scanRid);
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+	}
+
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,relationSize + 25,GT,relationSize + 40,LT), 14)
+	checkPassFail(intScan(&index,relationSize - 10,GTE,relationSize + 10,LT), 20)
+	checkPassFail(intScan(&index,0,GTE,2 * relationSize,LT), 2 * relationSize)
+}
+
+void sparseTests()
+{
+	std::cout << "Bulk load a B+ Tree index with one key per leaf and delete from it" << std::endl;
+	// two children per non-leaf, so levels with an odd number of nodes leave
+	// one child over at their end
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0.0001);
+
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize)
+
+	std::vector<RecordId> rids(relationSize);
+	{
+		FileScan fscan(relationName, bufMgr);
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				std::string recordStr = fscan.getRecord();
+				rids[*((int *)(recordStr.c_str() + offsetof(RECORD, i)))] = scanRid;
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+	}
+	int notDeleted = 0;
+	for (int key = relationSize - 1; key >= 0; key -= 2)
+	{
+		if (!index.deleteEntry(&key, rids[key]))
+			notDeleted++;
+	}
+	checkPassFail(notDeleted, 0)
+	checkPassFail(intScan(&index,25,GT,40,LT), 7)
+	checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize / 2)
+}
+
+/**
+ * Insert from several threads while another thread keeps scanning a range that
+ * none of the inserted keys fall into.
+ */
+void test6()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "createRelationForward" << std::endl;
+	createRelationForward();
+	concurrentTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	deleteRelation();
+}
+
+void concurrentTests()
+{
+	std::cout << "Insert into a B+ Tree index from 4 threads while scanning it" << std::endl;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	std::vector<RecordId> rids;
+	{
+		FileScan fscan(relationName, bufMgr);
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				rids.push_back(scanRid);
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+	}
+
+	const int numThreads = 4;
+	std::atomic<int> running(numThreads);
+	std::atomic<int> badScans(0);
+	std::vector<std::thread> inserters;
+	for (int t = 0; t < numThreads; t++)
+	{
+		inserters.push_back(std::thread([&, t]() {
+			for (int j = t; j < (int)rids.size(); j += numThreads)
+			{
+				int key = relationSize + j;
+				index.insertEntry(&key, rids[j]);
+			}
+			running--;
+		}));
+	}
+	std::thread scanner([&]() {
+		int lowVal = 0;
+		int highVal = relationSize;
+		while (running > 0)
+		{
+			int numResults = 0;
+			index.startScan(&lowVal, GTE, &highVal, LT);
+			try
+			{
+				RecordId scanRid;
+				while(1)
+				{
+					index.scanNext(scanRid);
+					numResults++;
+				}
+			}
+			catch(IndexScanCompletedException e)
+			{
+			}
+			index.endScan();
+			if (numResults != relationSize)
+				badScans++;
+		}
+	});
+	for (int t = 0; t < numThreads; t++)
+		inserters[t].join();
+	scanner.join();
+
+	checkPassFail(badScans.load(), 0)
+	checkPassFail(intScan(&index,relationSize + 25,GT,relationSize + 40,LT), 14)
+	checkPassFail(intScan(&index,0,GTE,2 * relationSize,LT), 2 * relationSize)
+}
+
+void test7()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "createRelationRandom" << std::endl;
+	createRelationRandom();
+	cursorTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	deleteRelation();
+}
+
+void cursorTests()
+{
+	std::cout << "Interleave two scan cursors on one B+ Tree index" << std::endl;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	ScanCursor lower(&index);
+	ScanCursor upper(&index);
+	int lowVal1 = 0, highVal1 = relationSize / 2;
+	int lowVal2 = relationSize / 2, highVal2 = relationSize;
+	lower.startScan(&lowVal1, GTE, &highVal1, LT);
+	upper.startScan(&lowVal2, GTE, &highVal2, LT);
+
+	int numResults1 = 0, numResults2 = 0;
+	bool done1 = false, done2 = false;
+	RecordId scanRid;
+	while (!done1 || !done2)
+	{
+		try
+		{
+			if (!done1)
+			{
+				lower.scanNext(scanRid);
+				numResults1++;
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+			done1 = true;
+		}
+		try
+		{
+			if (!done2)
+			{
+				upper.scanNext(scanRid);
+				numResults2++;
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+			done2 = true;
+		}
+	}
+	lower.endScan();
+
+	checkPassFail(numResults1, relationSize / 2)
+	checkPassFail(numResults2, relationSize - relationSize / 2)
+	// the index scan is independent of both cursors
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	// upper is still open and is ended by its destructor
+}
+
+void test8()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "createRelationRandom" << std::endl;
+	createRelationRandom();
+	batchTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	deleteRelation();
+}
+
+void batchTests()
+{
+	std::cout << "Scan a B+ Tree index in batches" << std::endl;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	checkPassFail(intScanBatch(&index,25,GT,40,LT,4), 14)
+	checkPassFail(intScanBatch(&index,20,GTE,35,LTE,16), 16)
+	checkPassFail(intScanBatch(&index,-3,GT,3,LT,1), 3)
+	checkPassFail(intScanBatch(&index,996,GT,1001,LT,100), 4)
+	checkPassFail(intScanBatch(&index,300,GT,400,LT,7), 99)
+	checkPassFail(intScanBatch(&index,3000,GTE,4000,LT,333), 1000)
+	checkPassFail(intScanBatch(&index,0,GTE,relationSize,LT,1000), relationSize)
+
+	// the vector overload appends, and an empty batch is returned once the scan is done
+	int lowVal = 0, highVal = relationSize;
+	std::vector<RecordId> rids;
+	index.startScan(&lowVal, GTE, &highVal, LTE);
+	while (index.scanNextBatch(rids, 1024) > 0)
+	{
+	}
+	index.endScan();
+	checkPassFail((int)rids.size(), relationSize)
+	std::vector<int> keys;
+	Page *curPage;
+	for (size_t j = 0; j < rids.size(); j++)
+	{
+		bufMgr->readPage(file1, rids[j].page_number, curPage);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[j]).data()));
+		bufMgr->unPinPage(file1, rids[j].page_number, false);
+		keys.push_back(myRec.i);
+	}
+	int outOfOrder = 0;
+	for (size_t j = 1; j < keys.size(); j++)
+	{
+		if (keys[j - 1] >= keys[j])
+			outOfOrder++;
+	}
+	checkPassFail(outOfOrder, 0)
+}
+
+int intScanBatch(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, size_t batchSize)
+{
+  std::cout << "Batch scan of " << batchSize << " for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	std::vector<RecordId> batch(batchSize);
+	int numResults = 0;
+	while(1)
+	{
+		size_t count = index->scanNextBatch(batch.data(), batchSize);
+		numResults += count;
+		if (count < batchSize)
+			break;
+	}
+	// a completed scan keeps returning empty batches
+	if (index->scanNextBatch(batch.data(), batchSize) != 0)
+		numResults = -1;
+
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+void test9()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "createRelationRandom" << std::endl;
+	createRelationRandom();
+	deleteTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	duplicateDeleteTests();
+	try
+	{
+		File::remove(intIndexName);
+		File::remove(stringIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	deleteRelation();
+}
+
+void deleteTests()
+{
+	std::cout << "Delete from a B+ Tree index" << std::endl;
+	// record id of every key in the relation
+	std::vector<RecordId> rids(relationSize);
+	{
+		FileScan fscan(relationName, bufMgr);
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				std::string recordStr = fscan.getRecord();
+				rids[*((int *)(recordStr.c_str() + offsetof(RECORD, i)))] = scanRid;
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+	}
+
+	std::streamoff fullSize;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+		// drop every other key, then keys missing or with the wrong record id
+		int notDeleted = 0;
+		for (int key = 0; key < relationSize; key += 2)
+		{
+			if (!index.deleteEntry(&key, rids[key]))
+				notDeleted++;
+		}
+		checkPassFail(notDeleted, 0)
+		int key = 0;
+		checkPassFail(index.deleteEntry(&key, rids[0]), false)
+		key = 1;
+		checkPassFail(index.deleteEntry(&key, rids[3]), false)
+		key = relationSize;
+		checkPassFail(index.deleteEntry(&key, rids[1]), false)
+
+		checkPassFail(intScan(&index,25,GT,40,LT), 7)
+		checkPassFail(intScan(&index,20,GTE,35,LTE), 8)
+		checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize / 2)
+
+		// delete the remaining keys from 4 threads until the root is a single empty leaf
+		const int numThreads = 4;
+		std::vector<std::thread> deleters;
+		std::atomic<int> failures(0);
+		for (int t = 0; t < numThreads; t++)
+		{
+			deleters.push_back(std::thread([&, t]() {
+				for (int j = 1 + 2 * t; j < relationSize; j += 2 * numThreads)
+				{
+					if (!index.deleteEntry(&j, rids[j]))
+						failures++;
+				}
+			}));
+		}
+		for (int t = 0; t < numThreads; t++)
+			deleters[t].join();
+		checkPassFail(failures.load(), 0)
+		checkPassFail(intScan(&index,0,GTE,relationSize,LT), 0)
+
+		// the index grows back into the pages the deletes freed
+		for (int j = 0; j < relationSize; j++)
+			index.insertEntry(&j, rids[j]);
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize)
+	}
+	{
+		std::ifstream indexFile(intIndexName.c_str(), std::ios::binary | std::ios::ate);
+		fullSize = indexFile.tellg();
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		for (int round = 0; round < 3; round++)
+		{
+			for (int j = 0; j < relationSize; j++)
+				index.deleteEntry(&j, rids[j]);
+			for (int j = 0; j < relationSize; j++)
+				index.insertEntry(&j, rids[j]);
+		}
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	}
+	std::ifstream indexFile(intIndexName.c_str(), std::ios::binary | std::ios::ate);
+	bool reused = indexFile.tellg() <= fullSize;
+	checkPassFail(reused, true)
+}
+
+/**
+ * Delete thousands of entries sharing one key, which span many leaves.
+ */
+void duplicateDeleteTests()
+{
+	std::cout << "Delete many duplicates of one key from B+ Tree indexes" << std::endl;
+	const int copies = 3 * INTARRAYLEAFSIZE;
+	RecordId rid;
+	rid.slot_number = 1;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		int key = 100;
+		for (int i = 0; i < copies; i++)
+		{
+			rid.page_number = relationSize + i;
+			index.insertEntry(&key, rid);
+		}
+		checkPassFail(intScanBatch(&index,99,GTE,101,LTE,64), copies + 3)
+
+		// every other copy first, so that leaves of duplicates merge with each other
+		int notDeleted = 0;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (int i = pass; i < copies; i += 2)
+			{
+				rid.page_number = relationSize + i;
+				if (!index.deleteEntry(&key, rid))
+					notDeleted++;
+			}
+			int left = pass == 0 ? copies / 2 + 3 : 3;
+			checkPassFail(intScanBatch(&index,99,GTE,101,LTE,64), left)
+		}
+		checkPassFail(notDeleted, 0)
+		rid.page_number = relationSize;
+		checkPassFail(index.deleteEntry(&key, rid), false)
+		checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize)
+		checkPassFail(intScan(&index,99,GTE,101,LTE), 3)
+	}
+	{
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+		char key[STRINGSIZE + 1];
+		sprintf(key, "%05d string record", 100);
+		for (int i = 0; i < copies; i++)
+		{
+			rid.page_number = relationSize + i;
+			index.insertEntry(key, rid);
+		}
+		int notDeleted = 0;
+		for (int i = copies - 1; i >= 0; i--)
+		{
+			rid.page_number = relationSize + i;
+			if (!index.deleteEntry(key, rid))
+				notDeleted++;
+		}
+		checkPassFail(notDeleted, 0)
+		checkPassFail(stringScan(&index,-1,GTE,relationSize,LT), relationSize)
+	}
+}
+
+void test10()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "createRelationRandom" << std::endl;
+	createRelationRandom();
+	doubleTests();
+	try
+	{
+		File::remove(doubleIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	deleteRelation();
+}
+
+void doubleTests()
+{
+	std::cout << "Create a B+ Tree index on the double field" << std::endl;
+	BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+
+	// run some tests
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+	checkPassFail(doubleScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(doubleScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(doubleScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(doubleScan(&index,0,GT,1,LT), 0)
+	checkPassFail(doubleScan(&index,25.5,GT,40.5,LT), 15)
+	checkPassFail(doubleScan(&index,0.25,GTE,0.75,LTE), 0)
+	checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+
+	// keys between the existing ones go into and come out of the same leaves
+	RecordId rid;
+	rid.page_number = 1;
+	rid.slot_number = 1;
+	for (int i = 0; i < relationSize; i++)
+	{
+		double key = i + 0.5;
+		index.insertEntry(&key, rid);
+	}
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 29)
+	checkPassFail(doubleScan(&index,25.5,GTE,25.5,LTE), 1)
+	int notDeleted = 0;
+	for (int i = 0; i < relationSize; i += 2)
+	{
+		double key = i + 0.5;
+		if (!index.deleteEntry(&key, rid))
+			notDeleted++;
+	}
+	checkPassFail(notDeleted, 0)
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 22)
+	checkPassFail(doubleScan(&index,-1,GTE,relationSize,LT), relationSize + relationSize / 2)
+}
+
+int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal, Operator highOp)
+{
+  RecordId scanRid;
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+		}
+		catch(IndexScanCompletedException e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+void test11()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "createRelationRandom" << std::endl;
+	createRelationRandom();
+	stringTests();
+	try
+	{
+		File::remove(stringIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	deleteRelation();
+}
+
+void stringTests()
+{
+	std::cout << "Create a B+ Tree index on the string field" << std::endl;
+	BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+	// run some tests
+	checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+	checkPassFail(stringScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(stringScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(stringScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(stringScan(&index,0,GT,1,LT), 0)
+	checkPassFail(stringScan(&index,300,GT,400,LT), 99)
+	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+
+	// longer keys sorting right after the existing ones split and merge the same leaves
+	RecordId rid;
+	rid.page_number = 1;
+	rid.slot_number = 1;
+	char key[64];
+	for (int i = 0; i < relationSize; i++)
+	{
+		sprintf(key, "%05d string record, inserted later as entry %05d", i, i);
+		index.insertEntry(key, rid);
+	}
+	checkPassFail(stringScan(&index,25,GT,40,LT), 29)
+	int notDeleted = 0;
+	for (int i = 0; i < relationSize; i += 2)
+	{
+		sprintf(key, "%05d string record, inserted later as entry %05d", i, i);
+		if (!index.deleteEntry(key, rid))
+			notDeleted++;
+	}
+	checkPassFail(notDeleted, 0)
+	checkPassFail(stringScan(&index,25,GT,40,LT), 22)
+	checkPassFail(stringScan(&index,-1,GTE,relationSize,LT), relationSize + relationSize / 2)
+}
+
+int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  RecordId scanRid;
+	char lowValStr[64];
+	char highValStr[64];
+	sprintf(lowValStr, "%05d string record", lowVal);
+	sprintf(highValStr, "%05d string record", highVal);
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowValStr << "," << highValStr;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+
+	try
+	{
+  	index->startScan(lowValStr, lowOp, highValStr, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+		}
+		catch(IndexScanCompletedException e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+void test12()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "createRelationRandom" << std::endl;
+	createRelationRandom();
+	lookupTests();
+	try
+	{
+		File::remove(intIndexName);
+		File::remove(stringIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	deleteRelation();
+}
+
+void lookupTests()
+{
+	std::cout << "Look up single keys in B+ Tree indexes" << std::endl;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	std::vector<RecordId> out;
+	int found = 0;
+	for (int key = 0; key < relationSize; key++)
+	{
+		out.clear();
+		if (index.lookup(&key, out) == 1 && out.size() == 1 && index.contains(&key))
+			found++;
+	}
+	checkPassFail(found, relationSize)
+	int key = -5;
+	checkPassFail(index.lookup(&key, out), 0)
+	checkPassFail(index.contains(&key), false)
+	key = relationSize;
+	checkPassFail(index.contains(&key), false)
+
+	// duplicates of one key are all returned, and lookups leave the index's scan alone
+	RecordId rid;
+	rid.slot_number = 1;
+	key = 100;
+	for (int i = 0; i < 3 * INTARRAYLEAFSIZE; i++)
+	{
+		rid.page_number = i + 1;
+		index.insertEntry(&key, rid);
+	}
+	int lowVal = 0;
+	int highVal = relationSize;
+	index.startScan(&lowVal, GTE, &highVal, LT);
+	RecordId scanRid;
+	index.scanNext(scanRid);
+	out.clear();
+	checkPassFail(index.lookup(&key, out), 3 * INTARRAYLEAFSIZE + 1)
+	checkPassFail(out.size(), 3 * INTARRAYLEAFSIZE + 1)
+	int scanned = 1;
+	std::vector<RecordId> rest;
+	scanned += index.scanNextBatch(rest, relationSize * 4);
+	index.endScan();
+	checkPassFail(scanned, relationSize + 3 * INTARRAYLEAFSIZE)
+
+	BTreeIndex stringIndex(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+	char stringKey[64];
+	sprintf(stringKey, "%05d string record", 4321);
+	out.clear();
+	checkPassFail(stringIndex.lookup(stringKey, out), 1)
+	sprintf(stringKey, "%05d string recor", 4321);
+	checkPassFail(stringIndex.contains(stringKey), false)
+}
+
+void test13()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "createRelationForward" << std::endl;
+	createRelationForward();
+	bufferTests();
+	concurrentBufferTests();
+	replacementTests();
+	ringTests();
+	backgroundWriterTests();
+	prefetchTests();
+	pageHandleTests();
+	flushFileTests();
+	fileBackendTests();
+	readIntoTests();
+	headerCacheTests();
+	allocationTests();
+	deleteRelation();
+}
+
+void bufferTests()
+{
+	std::cout << "Read and unpin pages without exceptions" << std::endl;
+	BufMgr smallBufMgr(3);
+	Page *page;
+	int read = 0;
+	for (PageId pageNo = 1; pageNo <= 3; pageNo++)
+	{
+		if (smallBufMgr.tryReadPage(file1, pageNo, page))
+			read++;
+	}
+	checkPassFail(read, 3)
+	// every frame is pinned, so a miss has nowhere to go
+	checkPassFail(smallBufMgr.tryReadPage(file1, 4, page), false)
+	// a hit still succeeds
+	checkPassFail(smallBufMgr.tryReadPage(file1, 2, page), true)
+	checkPassFail(smallBufMgr.tryUnPinPage(file1, 2, false), true)
+	checkPassFail(smallBufMgr.tryUnPinPage(file1, 2, false), true)
+	checkPassFail(smallBufMgr.tryUnPinPage(file1, 2, false), false)
+	checkPassFail(smallBufMgr.tryUnPinPage(file1, 4, false), false)
+	checkPassFail(smallBufMgr.tryReadPage(file1, 4, page), true)
+	smallBufMgr.unPinPage(file1, 1, false);
+	smallBufMgr.unPinPage(file1, 3, false);
+	smallBufMgr.unPinPage(file1, 4, false);
+
+	// cycle every page of the relation through the pool a few times, so the
+	// page table keeps evicting and refilling its entries
+	PageId lastPage = 0;
+	for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+		lastPage = (*iter).page_number();
+	int matched = 0;
+	for (int round = 0; round < 3; round++)
+	{
+		for (PageId pageNo = 1; pageNo <= lastPage; pageNo++)
+		{
+			smallBufMgr.readPage(file1, pageNo, page);
+			if (page->page_number() == pageNo)
+				matched++;
+			smallBufMgr.unPinPage(file1, pageNo, false);
+		}
+	}
+	checkPassFail(matched, 3 * (int)lastPage)
+
+	std::cout << "Evict a dirty page whose write fails" << std::endl;
+	const std::string evictName = "evict_test";
+	try
+	{
+		File::remove(evictName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		PageFile evictFile(evictName, true);
+		PageId pageNo;
+		evictFile.allocatePage(pageNo);
+		evictFile.allocatePage(pageNo);
+		BufMgr evictBufMgr(1);
+		evictBufMgr.readPage(&evictFile, 1, page);
+		evictBufMgr.unPinPage(&evictFile, 1, true);
+		// the page goes away under the pool, so writing it out fails
+		evictFile.deletePage(1);
+
+		// each attempt reports the failure and leaves the frame usable and dirty
+		int failed = 0;
+		for (int attempt = 0; attempt < 2; attempt++)
+		{
+			try
+			{
+				evictBufMgr.readPage(&evictFile, 2, page);
+			}
+			catch(InvalidPageException e)
+			{
+				failed++;
+			}
+		}
+		checkPassFail(failed, 2)
+
+		// once the page is back the write goes through
+		evictFile.allocatePage(pageNo);
+		checkPassFail(pageNo, 1)
+		evictBufMgr.readPage(&evictFile, 2, page);
+		evictBufMgr.unPinPage(&evictFile, 2, false);
+		checkPassFail(evictBufMgr.getBufStats().diskwrites, 1)
+	}
+	File::remove(evictName);
+}
+
+void concurrentBufferTests()
+{
+	std::cout << "Read pages into the buffer pool from several threads" << std::endl;
+	PageId lastPage = 0;
+	for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+		lastPage = (*iter).page_number();
+
+	// threads missing on the same page read it from disk only once
+	const int numThreads = 4;
+	BufMgr bigBufMgr(lastPage + 1);
+	std::vector<std::thread> readers;
+	std::atomic<int> matched(0);
+	for (int t = 0; t < numThreads; t++)
+	{
+		readers.push_back(std::thread([&]() {
+			for (PageId pageNo = 1; pageNo <= lastPage; pageNo++)
+			{
+				Page *page;
+				bigBufMgr.readPage(file1, pageNo, page);
+				if (page->page_number() == pageNo)
+					matched++;
+				bigBufMgr.unPinPage(file1, pageNo, false);
+			}
+		}));
+	}
+	for (int t = 0; t < numThreads; t++)
+		readers[t].join();
+	checkPassFail(matched.load(), numThreads * (int)lastPage)
+	checkPassFail(bigBufMgr.getBufStats().diskreads.load(), (int)lastPage)
+
+	// a pool smaller than the relation keeps evicting under the readers
+	BufMgr smallBufMgr(numThreads * 2);
+	readers.clear();
+	matched = 0;
+	for (int t = 0; t < numThreads; t++)
+	{
+		readers.push_back(std::thread([&, t]() {
+			for (int round = 0; round < 3; round++)
+			{
+				for (PageId pageNo = 1 + t; pageNo <= lastPage; pageNo++)
+				{
+					Page *page;
+					smallBufMgr.readPage(file1, pageNo, page);
+					if (page->page_number() == pageNo)
+						matched++;
+					smallBufMgr.unPinPage(file1, pageNo, false);
+				}
+			}
+		}));
+	}
+	int expected = 0;
+	for (int t = 0; t < numThreads; t++)
+	{
+		readers[t].join();
+		expected += 3 * ((int)lastPage - t);
+	}
+	checkPassFail(matched.load(), expected)
+	smallBufMgr.flushFile(file1);
+}
+
+void replacementTests()
+{
+	std::cout << "Compare replacement policies on a scan mixed with hot pages" << std::endl;
+	PageId lastPage = 0;
+	for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+		lastPage = (*iter).page_number();
+
+	const Replacement replacements[] = { CLOCK, LRU_K, TWO_Q, ARC };
+	const PageId hotPages = 4;
+	double clockRatio = 0;
+	for (int r = 0; r < 4; r++)
+	{
+		BufMgr policyBufMgr(hotPages * 3, replacements[r]);
+		Page *page;
+		int matched = 0;
+		int reads = 0;
+		// every hot page is read twice between two pages of the scan
+		for (int round = 0; round < 4; round++)
+		{
+			for (PageId scanPage = hotPages + 1; scanPage <= lastPage; scanPage++)
+			{
+				for (PageId pageNo = 1; pageNo <= hotPages; pageNo++)
+				{
+					for (int i = 0; i < 2; i++)
+					{
+						policyBufMgr.readPage(file1, pageNo, page);
+						matched += page->page_number() == pageNo;
+						policyBufMgr.unPinPage(file1, pageNo, false);
+						reads++;
+					}
+				}
+				policyBufMgr.readPage(file1, scanPage, page);
+				matched += page->page_number() == scanPage;
+				policyBufMgr.unPinPage(file1, scanPage, false);
+				reads++;
+			}
+		}
+		BufStats& stats = policyBufMgr.getBufStats();
+		std::cout << policyBufMgr.getPolicyName() << " hit ratio: " << stats.hitRatio() << std::endl;
+		checkPassFail(matched, reads)
+		checkPassFail(stats.hits + stats.misses, reads)
+		if (replacements[r] == CLOCK)
+			clockRatio = stats.hitRatio();
+		else
+		{
+			bool noWorseThanClock = stats.hitRatio() >= clockRatio;
+			checkPassFail(noWorseThanClock, true)
+		}
+		policyBufMgr.flushFile(file1);
+	}
+
+	// every policy keeps handing out distinct frames under concurrent readers
+	const int numThreads = 4;
+	for (int r = 0; r < 4; r++)
+	{
+		BufMgr policyBufMgr(numThreads * 2, replacements[r]);
+		std::vector<std::thread> readers;
+		std::atomic<int> matched(0);
+		for (int t = 0; t < numThreads; t++)
+		{
+			readers.push_back(std::thread([&, t]() {
+				for (PageId pageNo = 1; pageNo <= lastPage; pageNo++)
+				{
+					// each thread keeps going back to a hot page of its own
+					PageId readNo = pageNo % 2 ? pageNo : 1 + t;
+					Page *page;
+					policyBufMgr.readPage(file1, readNo, page);
+					if (page->page_number() == readNo)
+						matched++;
+					policyBufMgr.unPinPage(file1, readNo, false);
+				}
+			}));
+		}
+		for (int t = 0; t < numThreads; t++)
+			readers[t].join();
+		checkPassFail(matched.load(), numThreads * (int)lastPage)
+		policyBufMgr.flushFile(file1);
+	}
+}
+
+void ringTests()
+{
+	std::cout << "Scan through a buffer ring without evicting hot pages" << std::endl;
+	PageId lastPage = 0;
+	for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+		lastPage = (*iter).page_number();
+
+	const Replacement replacements[] = { CLOCK, LRU_K, TWO_Q, ARC };
+	const PageId hotPages = 4;
+	for (int r = 0; r < 4; r++)
+	{
+		BufMgr ringBufMgr(hotPages * 4, replacements[r]);
+		Page *page;
+		for (int i = 0; i < 2; i++)
+		{
+			for (PageId pageNo = 1; pageNo <= hotPages; pageNo++)
+			{
+				ringBufMgr.readPage(file1, pageNo, page);
+				ringBufMgr.unPinPage(file1, pageNo, false);
+			}
+		}
+
+		BufferRing ring(hotPages);
+		int matched = 0;
+		for (PageId pageNo = hotPages + 1; pageNo <= lastPage; pageNo++)
+		{
+			ringBufMgr.readPage(file1, pageNo, page, &ring);
+			matched += page->page_number() == pageNo;
+			ringBufMgr.unPinPage(file1, pageNo, false);
+		}
+		checkPassFail(matched, (int)(lastPage - hotPages))
+
+		// the hot pages are all still there
+		int diskreads = ringBufMgr.getBufStats().diskreads;
+		for (PageId pageNo = 1; pageNo <= hotPages; pageNo++)
+		{
+			ringBufMgr.readPage(file1, pageNo, page);
+			ringBufMgr.unPinPage(file1, pageNo, false);
+		}
+		checkPassFail(ringBufMgr.getBufStats().diskreads - diskreads, 0)
+		ringBufMgr.flushFile(file1);
+	}
+
+	// a bulk FileScan sees every record
+	int numRecords = 0;
+	{
+		FileScan fscan(relationName, bufMgr, true);
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				numRecords++;
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+	}
+	checkPassFail(numRecords, relationSize)
+}
+
+void backgroundWriterTests()
+{
+	std::cout << "Evict only clean pages with the background writer running" << std::endl;
+	const Replacement replacements[] = { CLOCK, LRU_K, TWO_Q, ARC };
+	const PageId poolSize = 16;
+	for (int r = 0; r < 4; r++)
+	{
+		BufMgr writerBufMgr(poolSize, replacements[r]);
+		writerBufMgr.startBackgroundWriter(1, poolSize, 0);
+		Page *page;
+		for (PageId pageNo = 1; pageNo <= poolSize; pageNo++)
+		{
+			writerBufMgr.readPage(file1, pageNo, page);
+			writerBufMgr.unPinPage(file1, pageNo, true);
+		}
+
+		// give the writer up to two seconds to catch up
+		for (int wait = 0; wait < 2000 && writerBufMgr.getBufStats().bgwrites < (int)poolSize; wait++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		checkPassFail(writerBufMgr.getBufStats().bgwrites, (int)poolSize)
+
+		// every victim is clean by now, so no eviction writes a page
+		for (PageId pageNo = poolSize + 1; pageNo <= 2 * poolSize; pageNo++)
+		{
+			writerBufMgr.readPage(file1, pageNo, page);
+			writerBufMgr.unPinPage(file1, pageNo, false);
+		}
+		checkPassFail(writerBufMgr.getBufStats().diskwrites, (int)poolSize)
+		writerBufMgr.stopBackgroundWriter();
+		writerBufMgr.flushFile(file1);
+	}
+}
+
+void prefetchTests()
+{
+	std::cout << "Prefetch pages so that reading them does not miss" << std::endl;
+	PageId lastPage = 0;
+	for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+		lastPage = (*iter).page_number();
+
+	const PageId prefetched = 8;
+	BufMgr prefetchBufMgr(16);
+	std::vector<PageId> pageNos;
+	for (PageId pageNo = 1; pageNo <= prefetched; pageNo++)
+		pageNos.push_back(pageNo);
+	prefetchBufMgr.prefetchPages(file1, pageNos);
+	// a page past the end of the file is dropped quietly
+	prefetchBufMgr.prefetchPage(file1, lastPage + 1);
+
+	for (int wait = 0; wait < 2000 && prefetchBufMgr.getBufStats().prefetches < (int)prefetched; wait++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	checkPassFail(prefetchBufMgr.getBufStats().prefetches, (int)prefetched)
+
+	int matched = 0;
+	int diskreads = prefetchBufMgr.getBufStats().diskreads;
+	Page *page;
+	for (PageId pageNo = 1; pageNo <= prefetched; pageNo++)
+	{
+		prefetchBufMgr.readPage(file1, pageNo, page);
+		matched += page->page_number() == pageNo;
+		prefetchBufMgr.unPinPage(file1, pageNo, false);
+	}
+	checkPassFail(matched, (int)prefetched)
+	checkPassFail(prefetchBufMgr.getBufStats().diskreads - diskreads, 0)
+	checkPassFail(prefetchBufMgr.getBufStats().misses, 0)
+
+	// queued prefetches are dropped by flushFile, so none is left to bring pages back
+	pageNos.clear();
+	for (PageId pageNo = prefetched + 1; pageNo <= lastPage && pageNo <= 4 * prefetched; pageNo++)
+		pageNos.push_back(pageNo);
+	prefetchBufMgr.prefetchPages(file1, pageNos);
+	prefetchBufMgr.flushFile(file1);
+	diskreads = prefetchBufMgr.getBufStats().diskreads;
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	checkPassFail(prefetchBufMgr.getBufStats().diskreads - diskreads, 0)
+}
+
+void pageHandleTests()
+{
+	std::cout << "Pin and unpin pages through handles" << std::endl;
+	BufMgr handleBufMgr(2);
+	{
+		PageHandle first = handleBufMgr.readPage(file1, 1);
+		checkPassFail(first.get()->page_number(), 1)
+		PageHandle second = handleBufMgr.readPage(file1, 2);
+		// both frames are pinned by the handles
+		Page *page;
+		bool read = handleBufMgr.tryReadPage(file1, 3, page);
+		checkPassFail(read, false)
+
+		// moving a handle moves the pin, and assigning over one drops its pin
+		PageHandle moved(std::move(second));
+		bool emptied = !second;
+		checkPassFail(emptied, true)
+		first.markDirty();
+		first = std::move(moved);
+		checkPassFail(first->page_number(), 2)
+		PageHandle third = handleBufMgr.readPage(file1, 3);
+		checkPassFail(third->page_number(), 3)
+	}
+	// going out of scope unpinned the rest, and only the marked page is written
+	Page *page;
+	for (PageId pageNo = 4; pageNo <= 5; pageNo++)
+	{
+		handleBufMgr.readPage(file1, pageNo, page);
+		handleBufMgr.unPinPage(page, false);
+	}
+	checkPassFail(handleBufMgr.getBufStats().diskwrites, 1)
+
+	// unpinning by page pointer still reports a page that is not pinned
+	checkPassFail(handleBufMgr.tryUnPinPage(page, false), false)
+	bool notPinned = false;
+	try
+	{
+		handleBufMgr.unPinPage(page, false);
+	}
+	catch (PageNotPinnedException e)
+	{
+		notPinned = true;
+	}
+	checkPassFail(notPinned, true)
+	handleBufMgr.flushFile(file1);
+}
+
+void flushFileTests()
+{
+	std::cout << "Flush one file while another one has pages pinned" << std::endl;
+	BufMgr flushBufMgr(8);
+	PageFile otherFile(relationName, false);
+	Page *page;
+	for (PageId pageNo = 1; pageNo <= 4; pageNo++)
+	{
+		flushBufMgr.readPage(file1, pageNo, page);
+		flushBufMgr.unPinPage(page, true);
+	}
+	PageHandle otherPage = flushBufMgr.readPage(&otherFile, 1);
+
+	// only the pages of file1 are written out and dropped
+	flushBufMgr.flushFile(file1);
+	int diskreads = flushBufMgr.getBufStats().diskreads;
+	for (PageId pageNo = 1; pageNo <= 4; pageNo++)
+	{
+		flushBufMgr.readPage(file1, pageNo, page);
+		flushBufMgr.unPinPage(page, false);
+	}
+	checkPassFail(flushBufMgr.getBufStats().diskreads - diskreads, 4)
+	PageHandle again = flushBufMgr.readPage(&otherFile, 1);
+	checkPassFail(flushBufMgr.getBufStats().diskreads - diskreads, 4)
+
+	otherPage.release();
+	again.release();
+	flushBufMgr.flushFile(file1);
+	flushBufMgr.flushFile(&otherFile);
+
+	std::cout << "Flush runs of consecutive pages with merged writes" << std::endl;
+	const std::string blobName = "blob_flush_test";
+	try
+	{
+		File::remove(blobName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	const PageId numPages = 20;
+	{
+		BlobFile blob(blobName, true);
+		{
+			BufMgr writeBufMgr(32);
+			for (PageId n = 0; n < numPages; n++)
+			{
+				PageId pageNo;
+				PageHandle handle = writeBufMgr.allocPage(&blob, pageNo);
+				memset(reinterpret_cast<char*>(handle.get()), (int)pageNo, Page::SIZE);
+			}
+			// all pages go out as one run; then rewrite one in the middle for the destructor
+			writeBufMgr.flushFile(&blob);
+			PageHandle handle = writeBufMgr.readPage(&blob, numPages / 2);
+			memset(reinterpret_cast<char*>(handle.get()), 0xff, Page::SIZE);
+			handle.markDirty();
+		}
+		// check every page on disk
+		int matched = 0;
+		for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+		{
+			Page page = blob.readPage(pageNo);
+			unsigned char expected = pageNo == numPages / 2 ? 0xff : (unsigned char)pageNo;
+			const unsigned char *bytes = (const unsigned char *)&page;
+			matched += bytes[0] == expected && bytes[Page::SIZE - 1] == expected;
+		}
+		checkPassFail(matched, (int)numPages)
+	}
+	File::remove(blobName);
+}
+
+void fileBackendTests()
+{
+	std::cout << "Allocate and read pages of a POSIX backed file from several threads" << std::endl;
+	const std::string backendName = "backend_test";
+	try
+	{
+		File::remove(backendName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	const int numThreads = 4;
+	const int pagesPerThread = 25;
+	File::setDefaultBackend(POSIX_IO);
+	{
+		PageFile posixFile(backendName, true);
+		checkPassFail(posixFile.backend(), POSIX_IO)
+
+		// allocations from every thread end up in the used page list
+		std::vector<std::thread> writers;
+		for (int t = 0; t < numThreads; t++)
+		{
+			writers.push_back(std::thread([&, t]() {
+				for (int n = 0; n < pagesPerThread; n++)
+				{
+					PageId pageNo;
+					Page page = posixFile.allocatePage(pageNo);
+					RECORD record;
+					memset(&record, 0, sizeof(record));
+					record.i = t * pagesPerThread + n;
+					page.insertRecord(std::string(reinterpret_cast<char*>(&record), sizeof(record)));
+					posixFile.writePage(pageNo, page);
+				}
+			}));
+		}
+		for (std::size_t t = 0; t < writers.size(); t++)
+			writers[t].join();
+		posixFile.sync();
+		int used = 0;
+		for (FileIterator iter = posixFile.begin(); iter != posixFile.end(); ++iter)
+			used++;
+		checkPassFail(used, numThreads * pagesPerThread)
+
+		// every page holds one record, read back concurrently
+		std::vector<std::thread> readers;
+		std::atomic<int> sum(0);
+		for (int t = 0; t < numThreads; t++)
+		{
+			readers.push_back(std::thread([&]() {
+				for (PageId pageNo = 1; pageNo <= (PageId)(numThreads * pagesPerThread); pageNo++)
+				{
+					Page page = posixFile.readPage(pageNo);
+					RecordId rid = {pageNo, 1};
+					sum += reinterpret_cast<const RECORD*>(page.getRecord(rid).c_str())->i;
+				}
+			}));
+		}
+		for (std::size_t t = 0; t < readers.size(); t++)
+			readers[t].join();
+		const int total = numThreads * pagesPerThread;
+		checkPassFail(sum, numThreads * total * (total - 1) / 2)
+	}
+	File::setDefaultBackend(STREAM_IO);
+
+	// the same file read back through a stream
+	{
+		PageFile streamFile(backendName, false);
+		checkPassFail(streamFile.backend(), STREAM_IO)
+		int sum = 0;
+		for (FileIterator iter = streamFile.begin(); iter != streamFile.end(); ++iter)
+		{
+			Page page = *iter;
+			RecordId rid = {page.page_number(), 1};
+			sum += reinterpret_cast<const RECORD*>(page.getRecord(rid).c_str())->i;
+		}
+		const int total = numThreads * pagesPerThread;
+		checkPassFail(sum, total * (total - 1) / 2)
+	}
+	File::remove(backendName);
+
+	std::cout << "Write a run of pages longer than one gathered write takes" << std::endl;
+	File::setDefaultBackend(POSIX_IO);
+	{
+		PageFile posixFile(backendName, true);
+		// two buffers a page, so the run needs more than one pwritev()
+		const int runLength = 600;
+		std::vector<Page> pages(runLength);
+		std::vector<const Page*> run;
+		for (int n = 0; n < runLength; n++)
+		{
+			PageId pageNo;
+			pages[n] = posixFile.allocatePage(pageNo);
+			RECORD record;
+			memset(&record, 0, sizeof(record));
+			record.i = n;
+			pages[n].insertRecord(std::string(reinterpret_cast<char*>(&record), sizeof(record)));
+			run.push_back(&pages[n]);
+		}
+		posixFile.writePages(1, run);
+		int matched = 0;
+		for (FileIterator iter = posixFile.begin(); iter != posixFile.end(); ++iter)
+		{
+			Page page = *iter;
+			RecordId rid = {page.page_number(), 1};
+			matched += reinterpret_cast<const RECORD*>(page.getRecord(rid).c_str())->i == (int)page.page_number() - 1;
+		}
+		checkPassFail(matched, runLength)
+	}
+	File::setDefaultBackend(STREAM_IO);
+	File::remove(backendName);
+
+	std::cout << "Read a growing blob file through a memory mapping" << std::endl;
+	File::setDefaultBackend(MMAP_IO);
+	{
+		BlobFile mmapFile(backendName, true);
+		checkPassFail(mmapFile.backend(), MMAP_IO)
+		// every page is read right after it is written, so the mapping has to follow the file
+		int matched = 0;
+		for (PageId n = 1; n <= 100; n++)
+		{
+			PageId pageNo;
+			Page page = mmapFile.allocatePage(pageNo);
+			memset(reinterpret_cast<char*>(&page), (int)pageNo, Page::SIZE);
+			mmapFile.writePage(pageNo, page);
+			Page readBack = mmapFile.readPage(pageNo);
+			const unsigned char *bytes = (const unsigned char *)&readBack;
+			matched += bytes[0] == (unsigned char)pageNo && bytes[Page::SIZE - 1] == (unsigned char)pageNo;
+		}
+		checkPassFail(matched, 100)
+		// a page past the end of the file reads as zeroes
+		Page past = mmapFile.readPage(200);
+		checkPassFail(((const unsigned char *)&past)[0], 0)
+	}
+	File::remove(backendName);
+
+	std::cout << "Scan and look up a B+ Tree index on a memory mapped file" << std::endl;
+	std::string mmapIndexName;
+	{
+		BTreeIndex index(relationName, mmapIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+		int key = 4242;
+		std::vector<RecordId> rids;
+		int found = (int)index.lookup(&key, rids);
+		checkPassFail(found, 1)
+	}
+	File::setDefaultBackend(STREAM_IO);
+	File::remove(mmapIndexName);
+}
+
+void readIntoTests()
+{
+	std::cout << "Read pages into place and reuse deleted pages" << std::endl;
+	const std::string intoName = "read_into_test";
+	try
+	{
+		File::remove(intoName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		PageFile intoFile(intoName, true);
+		for (int n = 0; n < 5; n++)
+		{
+			PageId pageNo;
+			Page page;
+			intoFile.allocatePageInto(pageNo, &page);
+			RECORD record;
+			memset(&record, 0, sizeof(record));
+			record.i = n;
+			page.insertRecord(std::string(reinterpret_cast<char*>(&record), sizeof(record)));
+			intoFile.writePage(pageNo, page);
+		}
+
+		// a deleted page can no longer be read, and is handed out again in its place in the list
+		intoFile.deletePage(3);
+		bool rejected = false;
+		Page page;
+		try
+		{
+			intoFile.readPageInto(3, &page);
+		}
+		catch(InvalidPageException e)
+		{
+			rejected = true;
+		}
+		checkPassFail(rejected, true)
+		PageId pageNo;
+		intoFile.allocatePageInto(pageNo, &page);
+		checkPassFail(pageNo, 3)
+		PageId expected = 1;
+		int inOrder = 0;
+		for (FileIterator iter = intoFile.begin(); iter != intoFile.end(); ++iter)
+			inOrder += (*iter).page_number() == expected++;
+		checkPassFail(inOrder, 5)
+
+		// a page read through the buffer pool matches the one read from the file
+		BufMgr intoBufMgr(4);
+		PageHandle handle = intoBufMgr.readPage(&intoFile, 2);
+		intoFile.readPageInto(2, &page);
+		bool same = memcmp(handle.get(), &page, Page::SIZE) == 0;
+		checkPassFail(same, true)
+		handle.release();
+		intoBufMgr.flushFile(&intoFile);
+	}
+	File::remove(intoName);
+}
+
+void headerCacheTests()
+{
+	std::cout << "Share the cached file header and write it back on sync" << std::endl;
+	const std::string headerName = "header_cache_test";
+	try
+	{
+		File::remove(headerName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		PageFile headerFile(headerName, true);
+		PageFile sameFile(headerName, false);
+		for (int n = 0; n < 3; n++)
+		{
+			PageId pageNo;
+			Page page = headerFile.allocatePage(pageNo);
+			headerFile.writePage(pageNo, page);
+		}
+		// the other object sees the new pages before the header reaches the disk
+		int used = 0;
+		for (FileIterator iter = sameFile.begin(); iter != sameFile.end(); ++iter)
+			used++;
+		checkPassFail(used, 3)
+
+		FileHeader onDisk;
+		std::ifstream before(headerName, std::ios::binary);
+		before.read(reinterpret_cast<char*>(&onDisk), sizeof(FileHeader));
+		bool written = onDisk.num_pages == 4;
+		checkPassFail(written, false)
+		sameFile.sync();
+		std::ifstream after(headerName, std::ios::binary);
+		after.read(reinterpret_cast<char*>(&onDisk), sizeof(FileHeader));
+		checkPassFail(onDisk.num_pages, 4)
+
+		// a page past the cached page count is rejected without touching the disk
+		bool rejected = false;
+		try
+		{
+			headerFile.readPage(4);
+		}
+		catch(InvalidPageException e)
+		{
+			rejected = true;
+		}
+		checkPassFail(rejected, true)
+	}
+	{
+		// the header written back on close is read again on open
+		PageFile headerFile(headerName, false);
+		PageId pageNo;
+		headerFile.allocatePage(pageNo);
+		checkPassFail(pageNo, 4)
+	}
+	File::remove(headerName);
+}
+
+void allocationTests()
+{
+	std::cout << "Allocate and delete pages at the head, middle and tail of the used list" << std::endl;
+	const std::string allocName = "allocation_test";
+	try
+	{
+		File::remove(allocName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		PageFile allocFile(allocName, true);
+		PageId pageNo;
+		for (int n = 0; n < 200; n++)
+			allocFile.allocatePage(pageNo);
+		allocFile.deletePage(1);
+		allocFile.deletePage(100);
+		allocFile.deletePage(200);
+		checkPassFail(usedPagesInOrder(allocFile), 197)
+		// the header keeps its size, so pages stay where earlier files have them
+		std::ifstream onDisk(allocName.c_str(), std::ios::binary | std::ios::ate);
+		bool fixedHeader = onDisk.tellg() == (std::streamoff)(16 + 200 * Page::SIZE);
+		checkPassFail(fixedHeader, true)
+
+		// deleted pages come back last deleted first, each in its place in the list
+		PageId reused[3];
+		for (int n = 0; n < 3; n++)
+			allocFile.allocatePage(reused[n]);
+		bool lifo = reused[0] == 200 && reused[1] == 100 && reused[2] == 1;
+		checkPassFail(lifo, true)
+		checkPassFail(usedPagesInOrder(allocFile), 200)
+	}
+	{
+		// after reopening the tail is the last page of the file; the used pages come from the list
+		PageFile allocFile(allocName, false);
+		PageId pageNo;
+		allocFile.allocatePage(pageNo);
+		checkPassFail(pageNo, 201)
+		allocFile.deletePage(201);
+		allocFile.deletePage(50);
+		checkPassFail(usedPagesInOrder(allocFile), 199)
+		allocFile.allocatePage(pageNo);
+		checkPassFail(pageNo, 50)
+		allocFile.allocatePage(pageNo);
+		checkPassFail(pageNo, 201)
+		checkPassFail(usedPagesInOrder(allocFile), 201)
+	}
+	File::remove(allocName);
+}
+
+/**
+ * Count the pages on the used list of a file, or return -1 if they are not in ascending order.
+ */
+int usedPagesInOrder(PageFile &file)
+{
+	int count = 0;
+	PageId last = 0;
+	for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+	{
+		PageId pageNo = (*iter).page_number();
+		if (pageNo <= last)
+			return -1;
+		last = pageNo;
+		count++;
+	}
+	return count;
+}
+
 // -----------------------------------------------------------------------------
 // createRelationForward
 // -----------------------------------------------------------------------------
@@ -0,0 +1,196 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "node_search.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NODE_SEARCH_X86
+#endif
+
+namespace badgerdb {
+
+namespace {
+
+typedef int (*SearchFunc)(const int *keys, const int count, const int key);
+typedef int (*DoubleSearchFunc)(const double *keys, const int count, const double key);
+
+/**
+ * Branchless binary search. On return the answer lies in [base, base + len]
+ * and len <= window, so it is found by counting the keys of the window that
+ * belong before it.
+ * Upper selects upper bound (keys <= key go left) instead of lower bound.
+ */
+template <bool Upper, class T>
+inline const T *narrow(const T *base, int &len, const T key, const int window)
+{
+  while (len > window) {
+    const int half = len / 2;
+    base = (Upper ? base[half] <= key : base[half] < key) ? base + half : base;
+    len -= half;
+  }
+  return base;
+}
+
+template <bool Upper, class T>
+int scalarSearch(const T *keys, const int count, const T key)
+{
+  int len = count;
+  const T *base = narrow<Upper>(keys, len, key, 1);
+  return (base - keys) + (len == 1 && (Upper ? *base <= key : *base < key));
+}
+
+#ifdef NODE_SEARCH_X86
+
+template <bool Upper>
+int sse2Search(const int *keys, const int count, const int key)
+{
+  int len = count;
+  const int *base = narrow<Upper>(keys, len, key, 16);
+  const __m128i keyVec = _mm_set1_epi32(key);
+  int i = 0;
+  int before = 0;
+  for (; i + 4 <= len; i += 4) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(base + i));
+    if (Upper) {
+      // count keys <= key as the ones not greater than it
+      before += 4 - __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, keyVec))));
+    } else {
+      before += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(keyVec, v))));
+    }
+  }
+  for (; i < len; ++i)
+    before += Upper ? base[i] <= key : base[i] < key;
+  return (base - keys) + before;
+}
+
+template <bool Upper>
+__attribute__((target("avx2")))
+int avx2Search(const int *keys, const int count, const int key)
+{
+  int len = count;
+  const int *base = narrow<Upper>(keys, len, key, 32);
+  const __m256i keyVec = _mm256_set1_epi32(key);
+  int i = 0;
+  int before = 0;
+  for (; i + 8 <= len; i += 8) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + i));
+    if (Upper) {
+      before += 8 - __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, keyVec))));
+    } else {
+      before += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(keyVec, v))));
+    }
+  }
+  for (; i < len; ++i)
+    before += Upper ? base[i] <= key : base[i] < key;
+  return (base - keys) + before;
+}
+
+template <bool Upper>
+int sse2SearchDouble(const double *keys, const int count, const double key)
+{
+  int len = count;
+  const double *base = narrow<Upper>(keys, len, key, 8);
+  const __m128d keyVec = _mm_set1_pd(key);
+  int i = 0;
+  int before = 0;
+  for (; i + 2 <= len; i += 2) {
+    const __m128d v = _mm_loadu_pd(base + i);
+    if (Upper) {
+      before += 2 - __builtin_popcount(_mm_movemask_pd(_mm_cmpgt_pd(v, keyVec)));
+    } else {
+      before += __builtin_popcount(_mm_movemask_pd(_mm_cmpgt_pd(keyVec, v)));
+    }
+  }
+  for (; i < len; ++i)
+    before += Upper ? base[i] <= key : base[i] < key;
+  return (base - keys) + before;
+}
+
+template <bool Upper>
+__attribute__((target("avx")))
+int avxSearchDouble(const double *keys, const int count, const double key)
+{
+  int len = count;
+  const double *base = narrow<Upper>(keys, len, key, 16);
+  const __m256d keyVec = _mm256_set1_pd(key);
+  int i = 0;
+  int before = 0;
+  for (; i + 4 <= len; i += 4) {
+    const __m256d v = _mm256_loadu_pd(base + i);
+    if (Upper) {
+      before += 4 - __builtin_popcount(_mm256_movemask_pd(_mm256_cmp_pd(v, keyVec, _CMP_GT_OQ)));
+    } else {
+      before += __builtin_popcount(_mm256_movemask_pd(_mm256_cmp_pd(keyVec, v, _CMP_GT_OQ)));
+    }
+  }
+  for (; i < len; ++i)
+    before += Upper ? base[i] <= key : base[i] < key;
+  return (base - keys) + before;
+}
+
+#endif
+
+/**
+ * @brief Search kernels picked for the CPU we are running on.
+ */
+struct SearchKernels {
+  SearchFunc lower;
+  SearchFunc upper;
+  DoubleSearchFunc lowerDouble;
+  DoubleSearchFunc upperDouble;
+};
+
+SearchKernels selectKernels()
+{
+  SearchKernels kernels = {scalarSearch<false, int>, scalarSearch<true, int>,
+                           scalarSearch<false, double>, scalarSearch<true, double> };
+#ifdef NODE_SEARCH_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.lower = avx2Search<false>;
+    kernels.upper = avx2Search<true>;
+  } else if (__builtin_cpu_supports("sse2")) {
+    kernels.lower = sse2Search<false>;
+    kernels.upper = sse2Search<true>;
+  }
+  if (__builtin_cpu_supports("avx")) {
+    kernels.lowerDouble = avxSearchDouble<false>;
+    kernels.upperDouble = avxSearchDouble<true>;
+  } else if (__builtin_cpu_supports("sse2")) {
+    kernels.lowerDouble = sse2SearchDouble<false>;
+    kernels.upperDouble = sse2SearchDouble<true>;
+  }
+#endif
+  return kernels;
+}
+
+const SearchKernels kernels = selectKernels();
+
+}
+
+int lowerBound(const int *keys, const int count, const int key)
+{
+  return kernels.lower(keys, count, key);
+}
+
+int upperBound(const int *keys, const int count, const int key)
+{
+  return kernels.upper(keys, count, key);
+}
+
+int lowerBound(const double *keys, const int count, const double key)
+{
+  return kernels.lowerDouble(keys, count, key);
+}
+
+int upperBound(const double *keys, const int count, const double key)
+{
+  return kernels.upperDouble(keys, count, key);
+}
+
+}
@@ -0,0 +1,61 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+namespace badgerdb {
+
+/**
+ * @brief Key search kernels used to probe the sorted key array of a B+ tree node.
+ *
+ * A branchless binary search narrows the range down to a small window which is then
+ * counted with SSE2 or AVX/AVX2 compare-and-movemask instructions. The variant is picked
+ * once at startup from what the CPU reports; on other platforms the binary search
+ * runs all the way down.
+ */
+
+/**
+ * Returns the index of the first key that is not less than key.
+ *
+ * @param keys   Keys sorted in ascending order.
+ * @param count  Number of keys in the array.
+ * @param key    Key to search for.
+ * @return  Index in [0, count].
+ */
+int lowerBound(const int *keys, const int count, const int key);
+
+/**
+ * Returns the index of the first key that is greater than key.
+ *
+ * @param keys   Keys sorted in ascending order.
+ * @param count  Number of keys in the array.
+ * @param key    Key to search for.
+ * @return  Index in [0, count].
+ */
+int upperBound(const int *keys, const int count, const int key);
+
+/**
+ * Returns the index of the first key that is not less than key.
+ *
+ * @param keys   Keys sorted in ascending order.
+ * @param count  Number of keys in the array.
+ * @param key    Key to search for.
+ * @return  Index in [0, count].
+ */
+int lowerBound(const double *keys, const int count, const double key);
+
+/**
+ * Returns the index of the first key that is greater than key.
+ *
+ * @param keys   Keys sorted in ascending order.
+ * @param count  Number of keys in the array.
+ * @param key    Key to search for.
+ * @return  Index in [0, count].
+ */
+int upperBound(const double *keys, const int count, const double key);
+
+}
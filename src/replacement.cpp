@@ -0,0 +1,634 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "buffer.h"
+#include "replacement.h"
+
+namespace badgerdb {
+
+bool ReplacementPolicy::tryClaim(const FrameId frame)
+{
+  int expected = 0;
+  return descTable[frame].pinCnt.compare_exchange_strong(expected, BufDesc::CLAIMED);
+}
+
+bool ReplacementPolicy::isPinned(const FrameId frame) const
+{
+  return descTable[frame].pinCnt != 0;
+}
+
+std::atomic<bool>& ReplacementPolicy::refbit(const FrameId frame)
+{
+  return descTable[frame].refbit;
+}
+
+/**
+ * @brief Single reference bit clock. The hand is an atomic counter, so the sweep takes no lock.
+ */
+class ClockPolicy : public ReplacementPolicy
+{
+ public:
+  ClockPolicy(BufDesc* descTable, const std::uint32_t numBufs)
+    : ReplacementPolicy(descTable, numBufs), clockHand(0) {}
+
+  const char* name() const { return "CLOCK"; }
+
+  bool pickVictim(const File* file, const PageId pageNo, FrameId& frame)
+  {
+    for (std::uint32_t numScanned = 0; numScanned < 2*numBufs; numScanned++)	//Need to scn twice
+    {
+      // advance the clock
+      FrameId hand = clockHand.fetch_add(1) % numBufs;
+
+      // skip pinned frames and frames other threads are claiming
+      if (isPinned(hand))
+        continue;
+
+      // has been referenced, clear the bit
+      if (refbit(hand).exchange(false))
+        continue;
+
+      // hasn't been referenced and is not pinned, use it
+      if (tryClaim(hand))
+      {
+        frame = hand;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void evictionCandidates(std::vector<FrameId>& frames, const std::uint32_t max)
+  {
+    // the frames just ahead of the clock hand
+    std::uint32_t hand = clockHand;
+    for (std::uint32_t i = 0; i < max && i < numBufs; i++)
+      frames.push_back((hand + i) % numBufs);
+  }
+
+  void loaded(const FrameId frame, const File* file, const PageId pageNo) { refbit(frame) = true; }
+
+  void loadedCold(const FrameId frame, const File* file, const PageId pageNo) { refbit(frame) = false; }
+
+  void accessed(const FrameId frame) { refbit(frame) = true; }
+
+  void evicted(const FrameId frame) {}
+
+  void removed(const FrameId frame) {}
+
+ private:
+  /**
+   * Current position of clockhand in our buffer pool, taken modulo numBufs
+   */
+  std::atomic<std::uint32_t> clockHand;
+};
+
+/**
+ * @brief Recency list of pages that are no longer in the pool, identified by pageKey().
+ */
+class GhostList
+{
+ public:
+  std::uint32_t size() const { return order.size(); }
+
+  bool contains(const std::uint64_t key) const { return where.count(key) > 0; }
+
+  void pushFront(const std::uint64_t key)
+  {
+    order.push_front(key);
+    where[key] = order.begin();
+  }
+
+  bool erase(const std::uint64_t key)
+  {
+    std::unordered_map<std::uint64_t, std::list<std::uint64_t>::iterator>::iterator it = where.find(key);
+    if (it == where.end())
+      return false;
+    order.erase(it->second);
+    where.erase(it);
+    return true;
+  }
+
+  std::uint64_t back() const { return order.back(); }
+
+  void popBack()
+  {
+    where.erase(order.back());
+    order.pop_back();
+  }
+
+ private:
+  std::list<std::uint64_t> order;
+  std::unordered_map<std::uint64_t, std::list<std::uint64_t>::iterator> where;
+};
+
+/**
+ * @brief Base of the policies that keep frames on lists under a mutex.
+ *
+ * Every frame is on exactly one list at a time, the free list included, so the
+ * lists are threaded through per-frame arrays instead of allocating nodes.
+ */
+class ListPolicy : public ReplacementPolicy
+{
+ public:
+  ListPolicy(BufDesc* descTable, const std::uint32_t numBufs)
+    : ReplacementPolicy(descTable, numBufs),
+      prev(numBufs), next(numBufs), owner(numBufs), keys(numBufs), cold(numBufs, false)
+  {
+    for (FrameId i = 0; i < numBufs; i++)
+    {
+      owner[i] = NULL;
+      pushFront(freeFrames, i);
+    }
+  }
+
+  void removed(const FrameId frame)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    unlink(frame);
+    pushFront(freeFrames, frame);
+  }
+
+ protected:
+  /**
+   * A list of frames, most recently inserted at the head
+   */
+  struct FrameList
+  {
+    FrameList() : head(NONE), tail(NONE), size(0) {}
+    FrameId head;
+    FrameId tail;
+    std::uint32_t size;
+  };
+
+  static const FrameId NONE = ~0u;
+
+  void pushFront(FrameList& list, const FrameId frame)
+  {
+    prev[frame] = NONE;
+    next[frame] = list.head;
+    if (list.head != NONE)
+      prev[list.head] = frame;
+    else
+      list.tail = frame;
+    list.head = frame;
+    list.size++;
+    owner[frame] = &list;
+  }
+
+  void pushBack(FrameList& list, const FrameId frame)
+  {
+    next[frame] = NONE;
+    prev[frame] = list.tail;
+    if (list.tail != NONE)
+      next[list.tail] = frame;
+    else
+      list.head = frame;
+    list.tail = frame;
+    list.size++;
+    owner[frame] = &list;
+  }
+
+  void unlink(const FrameId frame)
+  {
+    FrameList* list = owner[frame];
+    if (list == NULL)
+      return;
+    if (prev[frame] != NONE)
+      next[prev[frame]] = next[frame];
+    else
+      list->head = next[frame];
+    if (next[frame] != NONE)
+      prev[next[frame]] = prev[frame];
+    else
+      list->tail = prev[frame];
+    list->size--;
+    owner[frame] = NULL;
+  }
+
+  /**
+   * Claim the least recently inserted unpinned frame of a list. It stays on the
+   * list until the eviction is reported, or moves up if the eviction fails.
+   */
+  bool claimFromTail(FrameList& list, FrameId& frame)
+  {
+    for (FrameId f = list.tail; f != NONE; f = prev[f])
+    {
+      if (!isPinned(f) && tryClaim(f))
+      {
+        frame = f;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Append frames of a list to frames, least recently inserted first, until it holds max.
+   */
+  void listFromTail(const FrameList& list, std::vector<FrameId>& frames, const std::uint32_t max) const
+  {
+    for (FrameId f = list.tail; f != NONE && frames.size() < max; f = prev[f])
+      frames.push_back(f);
+  }
+
+  /**
+   * Claim a free frame; free frames are taken off the list since they get no eviction call.
+   */
+  bool claimFree(FrameId& frame)
+  {
+    if (!claimFromTail(freeFrames, frame))
+      return false;
+    unlink(frame);
+    return true;
+  }
+
+  /**
+   * Guards every list of the policy
+   */
+  std::mutex mutex;
+
+  std::vector<FrameId> prev;
+  std::vector<FrameId> next;
+
+  /**
+   * List each frame is on, NULL while it is between lists
+   */
+  std::vector<FrameList*> owner;
+
+  /**
+   * pageKey() of the page held in each frame
+   */
+  std::vector<std::uint64_t> keys;
+
+  /**
+   * True for frames loaded by loadedCold() and not referenced since
+   */
+  std::vector<bool> cold;
+
+  FrameList freeFrames;
+};
+
+/**
+ * @brief LRU-K with K = 2.
+ *
+ * Evicts the page whose second most recent reference is oldest; pages referenced
+ * only once go first, in LRU order. The last reference time of evicted pages is
+ * kept for as many pages as there are frames, so a page coming back soon counts
+ * its earlier reference.
+ */
+class LRUKPolicy : public ListPolicy
+{
+ public:
+  LRUKPolicy(BufDesc* descTable, const std::uint32_t numBufs)
+    : ListPolicy(descTable, numBufs), now(0), last(numBufs), penultimate(numBufs), resident(numBufs, false) {}
+
+  const char* name() const { return "LRU-2"; }
+
+  bool pickVictim(const File* file, const PageId pageNo, FrameId& frame)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (claimFree(frame))
+      return true;
+    for (std::set<Rank>::iterator it = order.begin(); it != order.end(); ++it)
+    {
+      if (!isPinned(it->second) && tryClaim(it->second))
+      {
+        frame = it->second;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void evictionCandidates(std::vector<FrameId>& frames, const std::uint32_t max)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    std::uint32_t limit = frames.size() + max;
+    for (std::set<Rank>::iterator it = order.begin(); it != order.end() && frames.size() < limit; ++it)
+      frames.push_back(it->second);
+  }
+
+  void loaded(const FrameId frame, const File* file, const PageId pageNo)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    keys[frame] = pageKey(file, pageNo);
+    penultimate[frame] = 0;
+    std::unordered_map<std::uint64_t, std::uint64_t>::iterator seen = history.find(keys[frame]);
+    if (seen != history.end())
+    {
+      penultimate[frame] = seen->second;
+      history.erase(seen);
+      historyOrder.erase(keys[frame]);
+    }
+    last[frame] = ++now;
+    order.insert(rank(frame));
+    resident[frame] = true;
+    cold[frame] = false;
+  }
+
+  void loadedCold(const FrameId frame, const File* file, const PageId pageNo)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    keys[frame] = pageKey(file, pageNo);
+    // ranks ahead of every page referenced for real
+    penultimate[frame] = 0;
+    last[frame] = 0;
+    order.insert(rank(frame));
+    resident[frame] = true;
+    cold[frame] = true;
+  }
+
+  void accessed(const FrameId frame)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (!resident[frame])
+      return;
+    cold[frame] = false;
+    order.erase(rank(frame));
+    penultimate[frame] = last[frame];
+    last[frame] = ++now;
+    order.insert(rank(frame));
+  }
+
+  void evicted(const FrameId frame)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    order.erase(rank(frame));
+    resident[frame] = false;
+    if (cold[frame])
+      return;
+    history[keys[frame]] = last[frame];
+    historyOrder.pushFront(keys[frame]);
+    if (historyOrder.size() > numBufs)
+    {
+      history.erase(historyOrder.back());
+      historyOrder.popBack();
+    }
+  }
+
+  void removed(const FrameId frame)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (resident[frame])
+      order.erase(rank(frame));
+    resident[frame] = false;
+    pushFront(freeFrames, frame);
+  }
+
+ private:
+  /**
+   * Eviction order: pages referenced once by last reference, then the others by
+   * their second most recent reference
+   */
+  typedef std::pair<std::pair<bool, std::uint64_t>, FrameId> Rank;
+
+  Rank rank(const FrameId frame) const
+  {
+    if (penultimate[frame] == 0)
+      return Rank(std::make_pair(false, last[frame]), frame);
+    return Rank(std::make_pair(true, penultimate[frame]), frame);
+  }
+
+  /**
+   * Logical clock counting references
+   */
+  std::uint64_t now;
+
+  std::vector<std::uint64_t> last;
+  std::vector<std::uint64_t> penultimate;
+  std::vector<bool> resident;
+  std::set<Rank> order;
+
+  /**
+   * Last reference of recently evicted pages, oldest evicted at the back of historyOrder
+   */
+  std::unordered_map<std::uint64_t, std::uint64_t> history;
+  GhostList historyOrder;
+};
+
+/**
+ * @brief 2Q. Pages enter a FIFO (A1in) and only move to the LRU list (Am) if they
+ * are read again after dropping out of it, while their key is still remembered
+ * in A1out. A long scan therefore cycles through A1in without disturbing Am.
+ */
+class TwoQPolicy : public ListPolicy
+{
+ public:
+  TwoQPolicy(BufDesc* descTable, const std::uint32_t numBufs)
+    : ListPolicy(descTable, numBufs),
+      maxIn(numBufs / 4 > 0 ? numBufs / 4 : 1), maxOut(numBufs / 2 > 0 ? numBufs / 2 : 1) {}
+
+  const char* name() const { return "2Q"; }
+
+  bool pickVictim(const File* file, const PageId pageNo, FrameId& frame)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (claimFree(frame))
+      return true;
+    if (in.size > maxIn)
+      return claimFromTail(in, frame) || claimFromTail(hot, frame);
+    return claimFromTail(hot, frame) || claimFromTail(in, frame);
+  }
+
+  void evictionCandidates(std::vector<FrameId>& frames, const std::uint32_t max)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    std::uint32_t limit = frames.size() + max;
+    listFromTail(in.size > maxIn ? in : hot, frames, limit);
+    listFromTail(in.size > maxIn ? hot : in, frames, limit);
+  }
+
+  void loaded(const FrameId frame, const File* file, const PageId pageNo)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    keys[frame] = pageKey(file, pageNo);
+    cold[frame] = false;
+    if (out.erase(keys[frame]))
+      pushFront(hot, frame);
+    else
+      pushFront(in, frame);
+  }
+
+  void loadedCold(const FrameId frame, const File* file, const PageId pageNo)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    keys[frame] = pageKey(file, pageNo);
+    cold[frame] = true;
+    pushBack(in, frame);
+  }
+
+  void accessed(const FrameId frame)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    cold[frame] = false;
+    // A1in is a FIFO, so only Am reorders on a hit
+    if (owner[frame] != &hot)
+      return;
+    unlink(frame);
+    pushFront(hot, frame);
+  }
+
+  void evicted(const FrameId frame)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (owner[frame] == &in && !cold[frame])
+    {
+      out.pushFront(keys[frame]);
+      if (out.size() > maxOut)
+        out.popBack();
+    }
+    unlink(frame);
+  }
+
+ private:
+  /**
+   * Target size of A1in and most keys remembered in A1out
+   */
+  std::uint32_t maxIn;
+  std::uint32_t maxOut;
+
+  FrameList in;
+  FrameList hot;
+  GhostList out;
+};
+
+/**
+ * @brief Adaptive replacement cache.
+ *
+ * T1 holds pages seen once and T2 pages seen more than once, each in LRU order.
+ * B1 and B2 remember the pages recently evicted from them. A miss that hits
+ * B1 grows the share of the pool given to T1, one that hits B2 shrinks it.
+ */
+class ARCPolicy : public ListPolicy
+{
+ public:
+  ARCPolicy(BufDesc* descTable, const std::uint32_t numBufs)
+    : ListPolicy(descTable, numBufs), target(0) {}
+
+  const char* name() const { return "ARC"; }
+
+  bool pickVictim(const File* file, const PageId pageNo, FrameId& frame)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    bool inB2 = false;
+    if (file != NULL)
+    {
+      std::uint64_t key = pageKey(file, pageNo);
+      inB2 = b2.contains(key);
+      if (b1.contains(key))
+        target = std::min(numBufs, target + std::max(1u, b2.size() / b1.size()));
+      else if (inB2)
+        target -= std::min(target, std::max(1u, b1.size() / b2.size()));
+    }
+    if (claimFree(frame))
+      return true;
+    if (t1.size > 0 && (t1.size > target || (inB2 && t1.size == target)))
+      return claimFromTail(t1, frame) || claimFromTail(t2, frame);
+    return claimFromTail(t2, frame) || claimFromTail(t1, frame);
+  }
+
+  void evictionCandidates(std::vector<FrameId>& frames, const std::uint32_t max)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    std::uint32_t limit = frames.size() + max;
+    bool t1First = t1.size > 0 && t1.size > target;
+    listFromTail(t1First ? t1 : t2, frames, limit);
+    listFromTail(t1First ? t2 : t1, frames, limit);
+  }
+
+  void loaded(const FrameId frame, const File* file, const PageId pageNo)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    keys[frame] = pageKey(file, pageNo);
+    cold[frame] = false;
+    if (b1.erase(keys[frame]) || b2.erase(keys[frame]))
+      pushFront(t2, frame);
+    else
+      pushFront(t1, frame);
+    trimGhosts();
+  }
+
+  void loadedCold(const FrameId frame, const File* file, const PageId pageNo)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    keys[frame] = pageKey(file, pageNo);
+    cold[frame] = true;
+    pushBack(t1, frame);
+  }
+
+  void accessed(const FrameId frame)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (owner[frame] != &t1 && owner[frame] != &t2)
+      return;
+    cold[frame] = false;
+    unlink(frame);
+    pushFront(t2, frame);
+  }
+
+  void evicted(const FrameId frame)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    // pages read in by bulk readers leave no history
+    if (!cold[frame])
+    {
+      if (owner[frame] == &t1)
+        b1.pushFront(keys[frame]);
+      else if (owner[frame] == &t2)
+        b2.pushFront(keys[frame]);
+    }
+    unlink(frame);
+    trimGhosts();
+  }
+
+ private:
+  /**
+   * Keep T1 and B1 within the pool size and all four lists within twice that
+   */
+  void trimGhosts()
+  {
+    while (t1.size + b1.size() > numBufs && b1.size() > 0)
+      b1.popBack();
+    while (t1.size + t2.size + b1.size() + b2.size() > 2 * numBufs && b2.size() > 0)
+      b2.popBack();
+  }
+
+  /**
+   * Number of frames T1 should hold
+   */
+  std::uint32_t target;
+
+  FrameList t1;
+  FrameList t2;
+  GhostList b1;
+  GhostList b2;
+};
+
+ReplacementPolicy* ReplacementPolicy::create(const Replacement replacement, BufDesc* descTable, const std::uint32_t numBufs)
+{
+  switch (replacement)
+  {
+    case LRU_K:
+      return new LRUKPolicy(descTable, numBufs);
+    case TWO_Q:
+      return new TwoQPolicy(descTable, numBufs);
+    case ARC:
+      return new ARCPolicy(descTable, numBufs);
+    default:
+      return new ClockPolicy(descTable, numBufs);
+  }
+}
+
+}
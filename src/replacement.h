@@ -0,0 +1,168 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "file.h"
+
+namespace badgerdb {
+
+class BufDesc;
+
+/**
+ * @brief Page replacement policies a BufMgr can be constructed with.
+ */
+enum Replacement
+{
+	CLOCK,	/* Single reference bit clock */
+	LRU_K,	/* LRU-K with K = 2 */
+	TWO_Q,	/* 2Q with a FIFO for pages seen once and an LRU for hot pages */
+	ARC		/* Adaptive replacement cache */
+};
+
+/**
+ * @brief Decides which buffer frame to reuse when a page has to be brought in.
+ *
+ * BufMgr reports every page it loads, every hit, and every frame it empties;
+ * the policy keeps whatever ordering it needs and proposes victims. A victim
+ * is claimed by the policy before it is returned, so two threads never pick
+ * the same frame. Only CLOCK is latch-free; the other policies guard their
+ * lists with a mutex of their own, which is never held while calling back
+ * into BufMgr.
+ */
+class ReplacementPolicy
+{
+ public:
+	/**
+	 * Create the policy of the given kind for a pool of frames.
+	 *
+	 * @param replacement  Kind of policy
+	 * @param descTable    Frame table of the buffer pool
+	 * @param numBufs      Number of frames in the buffer pool
+	 * @return  Newly allocated policy, owned by the caller
+	 */
+  static ReplacementPolicy* create(const Replacement replacement, BufDesc* descTable, const std::uint32_t numBufs);
+
+	/**
+	 * Destructor of ReplacementPolicy class
+	 */
+  virtual ~ReplacementPolicy() {}
+
+	/**
+	 * Returns the name of the policy, as used in statistics output.
+	 */
+  virtual const char* name() const = 0;
+
+	/**
+	 * Choose and claim a frame for a page that is about to be brought in.
+	 * The frame is either empty or still holds its old page, which the caller
+	 * must evict before reusing it.
+	 *
+	 * @param file   	File of the page to be brought in, NULL if the page is newly allocated
+	 * @param pageNo  Page number of the page to be brought in
+	 * @param frame   Frame ID of the claimed frame returned via this variable
+	 * @return  False if no unpinned frame could be claimed
+	 */
+  virtual bool pickVictim(const File* file, const PageId pageNo, FrameId& frame) = 0;
+
+	/**
+	 * List frames in the order the policy would pick them as victims, without
+	 * claiming them. Pinned frames may be included.
+	 *
+	 * @param frames  Frames are appended to this vector
+	 * @param max  	  Most frames to list
+	 */
+  virtual void evictionCandidates(std::vector<FrameId>& frames, const std::uint32_t max) = 0;
+
+	/**
+	 * A page has been brought into a frame the policy handed out.
+	 *
+	 * @param frame   Frame now holding the page
+	 * @param file   	File of the page
+	 * @param pageNo  Page number of the page
+	 */
+  virtual void loaded(const FrameId frame, const File* file, const PageId pageNo) = 0;
+
+	/**
+	 * A page has been brought into a frame for a bulk reader and is unlikely to
+	 * be read again soon. It should be among the first to go, and its eviction
+	 * should not count as history the way a regular page's does.
+	 *
+	 * @param frame   Frame now holding the page
+	 * @param file   	File of the page
+	 * @param pageNo  Page number of the page
+	 */
+  virtual void loadedCold(const FrameId frame, const File* file, const PageId pageNo) = 0;
+
+	/**
+	 * A page already in the pool has been pinned again, or resisted eviction.
+	 *
+	 * @param frame   Frame holding the page
+	 */
+  virtual void accessed(const FrameId frame) = 0;
+
+	/**
+	 * The page held in a frame returned by pickVictim() has been written out and unmapped.
+	 *
+	 * @param frame   Frame that held the page
+	 */
+  virtual void evicted(const FrameId frame) = 0;
+
+	/**
+	 * A frame has been emptied without being evicted, or handed back unused.
+	 *
+	 * @param frame   Frame that is free again
+	 */
+  virtual void removed(const FrameId frame) = 0;
+
+ protected:
+	/**
+	 * Constructor of ReplacementPolicy class
+	 */
+  ReplacementPolicy(BufDesc* descTable, const std::uint32_t numBufs)
+    : descTable(descTable), numBufs(numBufs) {}
+
+	/**
+	 * Claim a frame nobody has pinned, so no other thread can take it.
+	 *
+	 * @param frame   Frame to claim
+	 * @return  True if the frame is now claimed by the caller
+	 */
+  bool tryClaim(const FrameId frame);
+
+	/**
+	 * Returns true if the frame is pinned or claimed.
+	 */
+  bool isPinned(const FrameId frame) const;
+
+	/**
+	 * Returns the reference bit of a frame.
+	 */
+  std::atomic<bool>& refbit(const FrameId frame);
+
+	/**
+	 * Returns a key identifying (file, pageNo) among all pages.
+	 */
+  static std::uint64_t pageKey(const File* file, const PageId pageNo)
+  {
+    return ((std::uint64_t) file->id() << 32) | pageNo;
+  }
+
+	/**
+	 * Frame table of the buffer pool
+	 */
+  BufDesc* descTable;
+
+	/**
+	 * Number of frames in the buffer pool
+	 */
+  std::uint32_t numBufs;
+};
+
+}
@@ -0,0 +1,298 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "storage.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "exceptions/file_io_exception.h"
+
+namespace badgerdb {
+
+Storage* Storage::open(const std::string& filename, const IoBackend backend,
+                       const bool create_new) {
+  if (backend == POSIX_IO) {
+    return new PosixStorage(filename, create_new);
+  }
+  if (backend == MMAP_IO) {
+    return new MmapStorage(filename, create_new);
+  }
+  return new StreamStorage(filename, create_new);
+}
+
+void Storage::writev(const std::streamoff offset,
+                     const std::vector<IoBuffer>& buffers) {
+  std::streamoff position = offset;
+  for (std::size_t i = 0; i < buffers.size(); ++i) {
+    write(position, buffers[i].first, buffers[i].second);
+    position += buffers[i].second;
+  }
+}
+
+StreamStorage::StreamStorage(const std::string& filename, const bool create_new)
+    : Storage(filename) {
+  std::ios_base::openmode mode =
+      std::fstream::in | std::fstream::out | std::fstream::binary;
+  if (create_new) {
+    // New files have to be truncated on open.
+    mode = mode | std::fstream::trunc;
+  }
+  stream_.open(filename_, mode);
+  if (!stream_) {
+    throw FileIOException(filename_, "open", errno);
+  }
+}
+
+void StreamStorage::read(const std::streamoff offset, char* buffer,
+                         const std::size_t length) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  stream_.seekg(offset, std::ios::beg);
+  stream_.read(buffer, length);
+  const std::size_t count = stream_.gcount();
+  if (count < length) {
+    // ran into the end of the file; the stream has to be usable again
+    std::memset(buffer + count, 0, length - count);
+    stream_.clear();
+  }
+}
+
+void StreamStorage::write(const std::streamoff offset, const char* buffer,
+                          const std::size_t length) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  stream_.seekp(offset, std::ios::beg);
+  stream_.write(buffer, length);
+  stream_.flush();
+  if (!stream_) {
+    stream_.clear();
+    throw FileIOException(filename_, "write", errno);
+  }
+}
+
+void StreamStorage::sync() {
+  // every write is flushed already
+}
+
+PosixStorage::PosixStorage(const std::string& filename, const bool create_new)
+    : Storage(filename) {
+  int flags = O_RDWR;
+  if (create_new) {
+    flags |= O_CREAT | O_TRUNC;
+  }
+  fd_ = ::open(filename_.c_str(), flags, 0644);
+  if (fd_ < 0) {
+    throw FileIOException(filename_, "open", errno);
+  }
+}
+
+PosixStorage::~PosixStorage() {
+  ::close(fd_);
+}
+
+void PosixStorage::read(const std::streamoff offset, char* buffer,
+                        const std::size_t length) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t count = ::pread(fd_, buffer + done, length - done,
+                                  offset + done);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, "read", errno);
+    }
+    if (count == 0) {
+      // end of the file
+      std::memset(buffer + done, 0, length - done);
+      break;
+    }
+    done += count;
+  }
+}
+
+void PosixStorage::write(const std::streamoff offset, const char* buffer,
+                         const std::size_t length) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t count = ::pwrite(fd_, buffer + done, length - done,
+                                   offset + done);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, "write", errno);
+    }
+    done += count;
+  }
+}
+
+void PosixStorage::writev(const std::streamoff offset,
+                          const std::vector<IoBuffer>& buffers) {
+  std::vector<struct iovec> iov(buffers.size());
+  for (std::size_t i = 0; i < buffers.size(); ++i) {
+    iov[i].iov_base = const_cast<char*>(buffers[i].first);
+    iov[i].iov_len = buffers[i].second;
+  }
+  std::size_t first = 0;
+  std::streamoff position = offset;
+  while (first < iov.size()) {
+    const int count = std::min<std::size_t>(iov.size() - first, IOV_MAX);
+    ssize_t done = ::pwritev(fd_, &iov[first], count, position);
+    if (done < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, "write", errno);
+    }
+    position += done;
+    // skip the buffers written in full and carry on from the middle of the
+    // one written in part
+    while (first < iov.size() && (std::size_t) done >= iov[first].iov_len) {
+      done -= iov[first].iov_len;
+      ++first;
+    }
+    if (done > 0) {
+      iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + done;
+      iov[first].iov_len -= done;
+    }
+  }
+}
+
+void PosixStorage::sync() {
+  if (::fdatasync(fd_) != 0) {
+    throw FileIOException(filename_, "sync", errno);
+  }
+}
+
+void PosixStorage::advise(const AccessHint hint) {
+  int advice = POSIX_FADV_NORMAL;
+  if (hint == SEQUENTIAL_ACCESS) {
+    advice = POSIX_FADV_SEQUENTIAL;
+  } else if (hint == RANDOM_ACCESS) {
+    advice = POSIX_FADV_RANDOM;
+  }
+  // only a hint, so a failure is not worth reporting
+  ::posix_fadvise(fd_, 0, 0, advice);
+}
+
+MmapStorage::MmapStorage(const std::string& filename, const bool create_new)
+    : PosixStorage(filename, create_new), map_(NULL), capacity_(0), size_(0),
+      hint_(NORMAL_ACCESS) {
+  struct stat st;
+  if (::fstat(fd_, &st) != 0) {
+    throw FileIOException(filename_, "stat", errno);
+  }
+  size_ = st.st_size;
+}
+
+MmapStorage::~MmapStorage() {
+  if (map_ != NULL) {
+    ::munmap(map_, capacity_);
+  }
+}
+
+void MmapStorage::read(const std::streamoff offset, char* buffer,
+                       const std::size_t length) {
+  const std::uint64_t end = offset + length;
+  if (end > size_) {
+    // the file may have been extended by another process
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+      throw FileIOException(filename_, "stat", errno);
+    }
+    grow(st.st_size);
+  }
+  latch_.lockShared();
+  if (end > capacity_ && size_ > capacity_) {
+    latch_.unlock();
+    remap();
+    latch_.lockShared();
+  }
+  const std::uint64_t mapped = std::min<std::uint64_t>(capacity_, size_);
+  std::size_t count = 0;
+  if ((std::uint64_t) offset < mapped) {
+    count = std::min<std::uint64_t>(length, mapped - offset);
+    std::memcpy(buffer, map_ + offset, count);
+  }
+  latch_.unlock();
+  // end of the file
+  std::memset(buffer + count, 0, length - count);
+}
+
+void MmapStorage::write(const std::streamoff offset, const char* buffer,
+                        const std::size_t length) {
+  // the mapping is shared, so it sees the written bytes once they are in
+  // the page cache
+  PosixStorage::write(offset, buffer, length);
+  grow(offset + length);
+}
+
+void MmapStorage::writev(const std::streamoff offset,
+                         const std::vector<IoBuffer>& buffers) {
+  PosixStorage::writev(offset, buffers);
+  std::uint64_t end = offset;
+  for (std::size_t i = 0; i < buffers.size(); ++i) {
+    end += buffers[i].second;
+  }
+  grow(end);
+}
+
+void MmapStorage::advise(const AccessHint hint) {
+  hint_ = hint;
+  int advice = MADV_NORMAL;
+  if (hint == SEQUENTIAL_ACCESS) {
+    advice = MADV_SEQUENTIAL;
+  } else if (hint == RANDOM_ACCESS) {
+    advice = MADV_RANDOM;
+  }
+  latch_.lockShared();
+  if (map_ != NULL) {
+    ::madvise(map_, capacity_, advice);
+  }
+  latch_.unlock();
+}
+
+void MmapStorage::grow(const std::uint64_t size) {
+  std::uint64_t known = size_;
+  while (known < size && !size_.compare_exchange_weak(known, size)) {
+  }
+}
+
+void MmapStorage::remap() {
+  latch_.lockExclusive();
+  if (size_ <= capacity_) {
+    // another reader got here first
+    latch_.unlock();
+    return;
+  }
+  // double the mapping each time, so that appends remap rarely
+  const std::uint64_t pageSize = ::sysconf(_SC_PAGESIZE);
+  std::uint64_t capacity = std::max<std::uint64_t>(size_, capacity_ * 2);
+  capacity = (capacity + pageSize - 1) / pageSize * pageSize;
+  void* map = ::mmap(NULL, capacity, PROT_READ, MAP_SHARED, fd_, 0);
+  if (map == MAP_FAILED) {
+    const int error = errno;
+    latch_.unlock();
+    throw FileIOException(filename_, "map", error);
+  }
+  if (map_ != NULL) {
+    ::munmap(map_, capacity_);
+  }
+  map_ = static_cast<char*>(map);
+  capacity_ = capacity;
+  latch_.unlock();
+  advise(hint_);
+}
+
+}
@@ -0,0 +1,286 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "latch.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Ways a File can reach the file on disk underneath it.
+ */
+enum IoBackend {
+  STREAM_IO,  /* std::fstream, flushed after every write */
+  POSIX_IO,   /* File descriptor with positional pread/pwrite, synced on sync() */
+  MMAP_IO     /* As POSIX_IO, but reads are served from a shared read-only mapping */
+};
+
+/**
+ * @brief How a file is about to be read, passed on to the operating system
+ *        as a hint.
+ */
+enum AccessHint {
+  NORMAL_ACCESS,      /* No particular pattern */
+  SEQUENTIAL_ACCESS,  /* Pages are read in order, so read ahead aggressively */
+  RANDOM_ACCESS       /* Pages are probed one at a time, so do not read ahead */
+};
+
+/**
+ * @brief Start and length of one buffer of a gathered write.
+ */
+typedef std::pair<const char*, std::size_t> IoBuffer;
+
+/**
+ * @brief Byte-addressed access to an open file on disk.
+ *
+ * Every read and write names its own offset, so there is no shared file
+ * position and all methods may be called from several threads at once.
+ * A Storage is shared by all File objects open on the same file through their
+ * OpenFile.
+ */
+class Storage {
+ public:
+  /**
+   * Opens a file with the given backend.  The caller has already checked
+   * whether the file exists.
+   *
+   * @param filename    Name of the file.
+   * @param backend     Backend to access the file with.
+   * @param create_new  Whether to create the file, truncating it if it exists.
+   * @return  Newly allocated storage, owned by the caller.
+   * @throws  FileIOException  If the file could not be opened.
+   */
+  static Storage* open(const std::string& filename, const IoBackend backend,
+                       const bool create_new);
+
+  /**
+   * Closes the file.  Data written but not synced is not lost, but it is not
+   * known to be on disk either.
+   */
+  virtual ~Storage() {}
+
+  /**
+   * Reads bytes from the file.  Bytes past the end of the file read as zero.
+   *
+   * @param offset  Offset of the first byte to read.
+   * @param buffer  Buffer the bytes are read into.
+   * @param length  Number of bytes to read.
+   * @throws  FileIOException  If the read fails.
+   */
+  virtual void read(const std::streamoff offset, char* buffer,
+                    const std::size_t length) = 0;
+
+  /**
+   * Writes bytes into the file, growing it if needed.
+   *
+   * @param offset  Offset of the first byte to write.
+   * @param buffer  Bytes to write.
+   * @param length  Number of bytes to write.
+   * @throws  FileIOException  If the write fails.
+   */
+  virtual void write(const std::streamoff offset, const char* buffer,
+                     const std::size_t length) = 0;
+
+  /**
+   * Writes several buffers into the file back to back, growing it if needed.
+   * The buffers go out one write() at a time unless the backend can gather
+   * them into one call.
+   *
+   * @param offset   Offset of the first byte of the first buffer.
+   * @param buffers  Buffers to write, in file order.
+   * @throws  FileIOException  If the write fails.
+   */
+  virtual void writev(const std::streamoff offset,
+                      const std::vector<IoBuffer>& buffers);
+
+  /**
+   * Makes everything written so far durable.
+   *
+   * @throws  FileIOException  If the sync fails.
+   */
+  virtual void sync() = 0;
+
+  /**
+   * Tells the operating system how the whole file is about to be read.
+   * Does nothing for backends that take no hints.
+   *
+   * @param hint  Expected access pattern.
+   */
+  virtual void advise(const AccessHint hint) {}
+
+  /**
+   * Returns the backend the file was opened with.
+   */
+  virtual IoBackend backend() const = 0;
+
+  /**
+   * Returns the name of the file.
+   */
+  const std::string& filename() const { return filename_; }
+
+ protected:
+  /**
+   * Constructor of Storage class
+   */
+  explicit Storage(const std::string& filename) : filename_(filename) {}
+
+  /**
+   * Name of the file.
+   */
+  const std::string filename_;
+};
+
+/**
+ * @brief Storage on a std::fstream.  Reads and writes are serialized, since
+ *        they have to seek the stream first.
+ */
+class StreamStorage : public Storage {
+ public:
+  /**
+   * Opens the file.
+   *
+   * @see Storage::open()
+   */
+  StreamStorage(const std::string& filename, const bool create_new);
+
+  void read(const std::streamoff offset, char* buffer, const std::size_t length);
+  void write(const std::streamoff offset, const char* buffer,
+             const std::size_t length);
+  void sync();
+  IoBackend backend() const { return STREAM_IO; }
+
+ private:
+  /**
+   * Stream for the file.
+   */
+  std::fstream stream_;
+
+  /**
+   * Guards the stream and its position.
+   */
+  std::mutex mutex_;
+};
+
+/**
+ * @brief Storage on a POSIX file descriptor.  Reads and writes are positional
+ *        and run concurrently; writes reach the disk on sync().  Gathered
+ *        writes are a single pwritev().
+ */
+class PosixStorage : public Storage {
+ public:
+  /**
+   * Opens the file.
+   *
+   * @see Storage::open()
+   */
+  PosixStorage(const std::string& filename, const bool create_new);
+
+  /**
+   * Closes the file descriptor.
+   */
+  ~PosixStorage();
+
+  void read(const std::streamoff offset, char* buffer, const std::size_t length);
+  void write(const std::streamoff offset, const char* buffer,
+             const std::size_t length);
+  void writev(const std::streamoff offset,
+              const std::vector<IoBuffer>& buffers);
+  void sync();
+  void advise(const AccessHint hint);
+  IoBackend backend() const { return POSIX_IO; }
+
+ protected:
+  /**
+   * File descriptor of the file.
+   */
+  int fd_;
+};
+
+/**
+ * @brief Storage that reads from a shared mapping of the file and writes
+ *        through its descriptor.  Meant for read-mostly files such as
+ *        indexes: a read of data already in the page cache is a copy out of
+ *        the mapping, without a system call.
+ *
+ * The mapping is made larger than the file, so that a growing file is only
+ * remapped once in a while.  Bytes past the known end of the file are never
+ * touched through the mapping.
+ */
+class MmapStorage : public PosixStorage {
+ public:
+  /**
+   * Opens the file.  It is mapped on the first read.
+   *
+   * @see Storage::open()
+   */
+  MmapStorage(const std::string& filename, const bool create_new);
+
+  /**
+   * Unmaps and closes the file.
+   */
+  ~MmapStorage();
+
+  void read(const std::streamoff offset, char* buffer, const std::size_t length);
+  void write(const std::streamoff offset, const char* buffer,
+             const std::size_t length);
+  void writev(const std::streamoff offset,
+              const std::vector<IoBuffer>& buffers);
+  void advise(const AccessHint hint);
+  IoBackend backend() const { return MMAP_IO; }
+
+ private:
+  /**
+   * Raises the known size of the file to at least the given size.
+   *
+   * @param size  Size the file is known to have.
+   */
+  void grow(const std::uint64_t size);
+
+  /**
+   * Maps the file again if it has grown past the end of the mapping.
+   *
+   * @throws  FileIOException  If the file could not be mapped.
+   */
+  void remap();
+
+  /**
+   * Start of the mapping, NULL before the first one.
+   */
+  char* map_;
+
+  /**
+   * Length of the mapping.
+   */
+  std::uint64_t capacity_;
+
+  /**
+   * Known size of the file, which only grows.
+   */
+  std::atomic<std::uint64_t> size_;
+
+  /**
+   * Last hint given, applied again to every new mapping.
+   */
+  std::atomic<AccessHint> hint_;
+
+  /**
+   * Held shared while reading from the mapping and exclusive while replacing it.
+   */
+  RWLatch latch_;
+};
+
+}
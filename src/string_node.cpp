@@ -0,0 +1,392 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "string_node.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+
+namespace badgerdb {
+
+namespace {
+
+const int LEAF_HEADER_SIZE = offsetof(StringLeafNode, slotArray);
+const int NONLEAF_HEADER_SIZE = offsetof(StringNonLeafNode, slotArray);
+
+/**
+ * Length of the longest common prefix of two keys.
+ */
+int commonPrefixLength(const std::string &a, const std::string &b)
+{
+  const size_t len = std::min(a.size(), b.size());
+  size_t i = 0;
+  while (i < len && a[i] == b[i])
+    ++i;
+  return i;
+}
+
+/**
+ * Compares a key stored as prefix plus suffix in a node with key.
+ */
+int compareStored(const char *base, const int prefixLength, const int offset, const int length,
+                  const std::string &key)
+{
+  const size_t prefix = prefixLength;
+  int c = memcmp(base + Page::SIZE - prefix, key.data(), std::min(prefix, key.size()));
+  if (c != 0)
+    return c;
+  if (key.size() < prefix)
+    return 1;
+  const size_t rest = key.size() - prefix;
+  c = memcmp(base + offset, key.data() + prefix, std::min<size_t>(length, rest));
+  if (c != 0)
+    return c;
+  return length - (int)rest;
+}
+
+/**
+ * Bytes taken up by the keys [begin, end) of a node with slots of slotSize bytes.
+ */
+int encodedSize(const std::vector<std::string> &keys, const int begin, const int end,
+                const int headerSize, const int slotSize)
+{
+  int size = headerSize + (end - begin) * slotSize;
+  if (end == begin)
+    return size;
+  const int prefix = commonPrefixLength(keys[begin], keys[end - 1]);
+  size += prefix;
+  for (int i = begin; i < end; ++i)
+    size += keys[i].size() - prefix;
+  return size;
+}
+
+/**
+ * Bytes taken up by the keys [begin, end) of a node, given sums[i], the total length of the first i keys.
+ */
+int rangeSize(const std::vector<std::string> &keys, const std::vector<int> &sums, const int begin,
+              const int end, const int headerSize, const int slotSize)
+{
+  const int count = end - begin;
+  if (count == 0)
+    return headerSize;
+  const int prefix = commonPrefixLength(keys[begin], keys[end - 1]);
+  return headerSize + count * slotSize + prefix + sums[end] - sums[begin] - count * prefix;
+}
+
+/**
+ * Number of keys from begin on that fit in budget bytes, but at least one if there is any.
+ */
+int fillCount(const std::vector<std::string> &keys, const int begin, const int budget,
+              const int headerSize, const int slotSize)
+{
+  const int total = keys.size();
+  int end = begin;
+  int sum = 0;
+  while (end < total) {
+    sum += keys[end].size();
+    const int count = end + 1 - begin;
+    const int prefix = commonPrefixLength(keys[begin], keys[end]);
+    if (end > begin && headerSize + count * slotSize + prefix + sum - count * prefix > budget)
+      break;
+    ++end;
+  }
+  return end - begin;
+}
+
+/**
+ * Writes the shared prefix and the suffixes of keys [begin, end) from the end of the page down.
+ * Calls setSlot(i, offset, length) for each key, and returns the prefix length and final heap offset.
+ */
+template <class SetSlot>
+void writeKeys(char *base, const std::vector<std::string> &keys, const int begin, const int end,
+               std::uint16_t &prefixLength, std::uint16_t &heapOffset, SetSlot setSlot)
+{
+  int prefix = end > begin ? commonPrefixLength(keys[begin], keys[end - 1]) : 0;
+  int offset = Page::SIZE - prefix;
+  if (prefix > 0)
+    memcpy(base + offset, keys[begin].data(), prefix);
+  for (int i = begin; i < end; ++i) {
+    const int length = keys[i].size() - prefix;
+    offset -= length;
+    memcpy(base + offset, keys[i].data() + prefix, length);
+    setSlot(i - begin, offset, length);
+  }
+  prefixLength = prefix;
+  heapOffset = offset;
+}
+
+}
+
+std::string stringKey(const StringLeafNode *node, const int i)
+{
+  const char *base = reinterpret_cast<const char *>(node);
+  std::string key(base + Page::SIZE - node->prefixLength, node->prefixLength);
+  key.append(base + node->slotArray[i].offset, node->slotArray[i].length);
+  return key;
+}
+
+std::string stringKey(const StringNonLeafNode *node, const int i)
+{
+  const char *base = reinterpret_cast<const char *>(node);
+  std::string key(base + Page::SIZE - node->prefixLength, node->prefixLength);
+  key.append(base + node->slotArray[i].offset, node->slotArray[i].length);
+  return key;
+}
+
+int compareStringKey(const StringLeafNode *node, const int i, const std::string &key)
+{
+  return compareStored(reinterpret_cast<const char *>(node), node->prefixLength,
+                       node->slotArray[i].offset, node->slotArray[i].length, key);
+}
+
+int lowerBound(const StringLeafNode *node, const std::string &key)
+{
+  int low = 0;
+  int high = node->numKeys;
+  while (low < high) {
+    const int mid = (low + high) / 2;
+    if (compareStringKey(node, mid, key) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+int upperBound(const StringLeafNode *node, const std::string &key)
+{
+  int low = 0;
+  int high = node->numKeys;
+  while (low < high) {
+    const int mid = (low + high) / 2;
+    if (compareStringKey(node, mid, key) <= 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+int lowerBound(const StringNonLeafNode *node, const std::string &key)
+{
+  const char *base = reinterpret_cast<const char *>(node);
+  int low = 0;
+  int high = node->numKeys;
+  while (low < high) {
+    const int mid = (low + high) / 2;
+    if (compareStored(base, node->prefixLength, node->slotArray[mid].offset,
+                      node->slotArray[mid].length, key) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+int upperBound(const StringNonLeafNode *node, const std::string &key)
+{
+  const char *base = reinterpret_cast<const char *>(node);
+  int low = 0;
+  int high = node->numKeys;
+  while (low < high) {
+    const int mid = (low + high) / 2;
+    if (compareStored(base, node->prefixLength, node->slotArray[mid].offset,
+                      node->slotArray[mid].length, key) <= 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+PageId childPageNo(const StringNonLeafNode *node, const int i)
+{
+  return i == 0 ? node->firstPageNo : node->slotArray[i - 1].pageNo;
+}
+
+int stringLeafSize(const std::vector<std::string> &keys, const int begin, const int end)
+{
+  return encodedSize(keys, begin, end, LEAF_HEADER_SIZE, sizeof(StringLeafSlot));
+}
+
+int stringNonLeafSize(const std::vector<std::string> &keys, const int begin, const int end)
+{
+  return encodedSize(keys, begin, end, NONLEAF_HEADER_SIZE, sizeof(StringNonLeafSlot));
+}
+
+int stringLeafSize(const StringLeafNode *node, const bool withoutPrefix)
+{
+  int size = LEAF_HEADER_SIZE + node->numKeys * sizeof(StringLeafSlot) + Page::SIZE - node->heapOffset;
+  if (withoutPrefix && node->numKeys > 1)
+    size += (node->numKeys - 1) * node->prefixLength;
+  return size;
+}
+
+int stringNonLeafSize(const StringNonLeafNode *node, const bool withoutPrefix)
+{
+  int size = NONLEAF_HEADER_SIZE + node->numKeys * sizeof(StringNonLeafSlot) + Page::SIZE - node->heapOffset;
+  if (withoutPrefix && node->numKeys > 1)
+    size += (node->numKeys - 1) * node->prefixLength;
+  return size;
+}
+
+void decodeStringLeaf(const StringLeafNode *node, std::vector<std::string> &keys, std::vector<RecordId> &rids)
+{
+  keys.clear();
+  rids.clear();
+  for (int i = 0; i < node->numKeys; ++i) {
+    keys.push_back(stringKey(node, i));
+    rids.push_back(node->slotArray[i].rid);
+  }
+}
+
+void decodeStringNonLeaf(const StringNonLeafNode *node, std::vector<std::string> &keys, std::vector<PageId> &pageNos)
+{
+  keys.clear();
+  pageNos.clear();
+  pageNos.push_back(node->firstPageNo);
+  for (int i = 0; i < node->numKeys; ++i) {
+    keys.push_back(stringKey(node, i));
+    pageNos.push_back(node->slotArray[i].pageNo);
+  }
+}
+
+namespace {
+
+struct SetLeafSlot {
+  StringLeafNode *node;
+  const std::vector<RecordId> *rids;
+  int begin;
+  void operator()(const int i, const int offset, const int length) const {
+    node->slotArray[i].offset = offset;
+    node->slotArray[i].length = length;
+    node->slotArray[i].rid = (*rids)[begin + i];
+  }
+};
+
+struct SetNonLeafSlot {
+  StringNonLeafNode *node;
+  const std::vector<PageId> *pageNos;
+  int begin;
+  void operator()(const int i, const int offset, const int length) const {
+    node->slotArray[i].offset = offset;
+    node->slotArray[i].length = length;
+    node->slotArray[i].pageNo = (*pageNos)[begin + i + 1];
+  }
+};
+
+}
+
+bool encodeStringLeaf(StringLeafNode *node, const std::vector<std::string> &keys,
+                      const std::vector<RecordId> &rids, const int begin, const int end)
+{
+  if (stringLeafSize(keys, begin, end) > (int)Page::SIZE)
+    return false;
+  SetLeafSlot setSlot = {node, &rids, begin};
+  writeKeys(reinterpret_cast<char *>(node), keys, begin, end, node->prefixLength, node->heapOffset, setSlot);
+  node->numKeys = end - begin;
+  return true;
+}
+
+bool encodeStringNonLeaf(StringNonLeafNode *node, const std::vector<std::string> &keys,
+                         const std::vector<PageId> &pageNos, const int begin, const int end)
+{
+  if (stringNonLeafSize(keys, begin, end) > (int)Page::SIZE)
+    return false;
+  SetNonLeafSlot setSlot = {node, &pageNos, begin};
+  writeKeys(reinterpret_cast<char *>(node), keys, begin, end, node->prefixLength, node->heapOffset, setSlot);
+  node->firstPageNo = pageNos[begin];
+  node->numKeys = end - begin;
+  return true;
+}
+
+int stringLeafFill(const std::vector<std::string> &keys, const int begin, const int budget)
+{
+  return fillCount(keys, begin, budget, LEAF_HEADER_SIZE, sizeof(StringLeafSlot));
+}
+
+int stringNonLeafFill(const std::vector<std::string> &keys, const int begin, const int budget)
+{
+  return fillCount(keys, begin, budget, NONLEAF_HEADER_SIZE, sizeof(StringNonLeafSlot));
+}
+
+int stringSplitPoint(const std::vector<std::string> &keys, const bool isLeaf)
+{
+  const int total = keys.size();
+  const int headerSize = isLeaf ? LEAF_HEADER_SIZE : NONLEAF_HEADER_SIZE;
+  const int slotSize = isLeaf ? sizeof(StringLeafSlot) : sizeof(StringNonLeafSlot);
+  std::vector<int> sums(total + 1, 0);
+  for (int i = 0; i < total; ++i)
+    sums[i + 1] = sums[i] + keys[i].size();
+  // a non-leaf moves key k up, and keeps at least one key on either side
+  const int first = 1;
+  const int last = isLeaf ? total - 1 : total - 2;
+  int best = total / 2;
+  int bestScore = -1;
+  for (int k = first; k <= last; ++k) {
+    const int leftSize = rangeSize(keys, sums, 0, k, headerSize, slotSize);
+    const int rightSize = rangeSize(keys, sums, isLeaf ? k : k + 1, total, headerSize, slotSize);
+    if (leftSize > (int)Page::SIZE || rightSize > (int)Page::SIZE)
+      continue;
+    int score = std::abs(leftSize - rightSize);
+    // splitting a run of equal keys in a leaf would hide the left part of it from searches
+    if (isLeaf && keys[k - 1] == keys[k])
+      score += Page::SIZE;
+    if (bestScore < 0 || score < bestScore) {
+      best = k;
+      bestScore = score;
+    }
+  }
+  return best;
+}
+
+bool insertStringLeafEntry(StringLeafNode *node, const int i, const std::string &key, const RecordId rid)
+{
+  char *base = reinterpret_cast<char *>(node);
+  const int prefix = node->prefixLength;
+  if ((int)key.size() < prefix || memcmp(base + Page::SIZE - prefix, key.data(), prefix) != 0)
+    return false;
+  const int length = key.size() - prefix;
+  const int freeSpace = node->heapOffset - LEAF_HEADER_SIZE - node->numKeys * (int)sizeof(StringLeafSlot);
+  if (freeSpace < (int)sizeof(StringLeafSlot) + length)
+    return false;
+  memmove(&node->slotArray[i + 1], &node->slotArray[i], (node->numKeys - i) * sizeof(StringLeafSlot));
+  node->heapOffset -= length;
+  memcpy(base + node->heapOffset, key.data() + prefix, length);
+  node->slotArray[i].offset = node->heapOffset;
+  node->slotArray[i].length = length;
+  node->slotArray[i].rid = rid;
+  node->numKeys++;
+  return true;
+}
+
+void removeStringLeafEntry(StringLeafNode *node, const int i)
+{
+  char *base = reinterpret_cast<char *>(node);
+  const int offset = node->slotArray[i].offset;
+  const int length = node->slotArray[i].length;
+  // close the gap by moving the key bytes below it up
+  memmove(base + node->heapOffset + length, base + node->heapOffset, offset - node->heapOffset);
+  node->heapOffset += length;
+  memmove(&node->slotArray[i], &node->slotArray[i + 1], (node->numKeys - i - 1) * sizeof(StringLeafSlot));
+  node->numKeys--;
+  for (int j = 0; j < node->numKeys; ++j) {
+    if (node->slotArray[j].offset < offset)
+      node->slotArray[j].offset += length;
+  }
+}
+
+std::string truncatedSeparator(const std::string &left, const std::string &right)
+{
+  if (left == right)
+    return right;
+  return right.substr(0, commonPrefixLength(left, right) + 1);
+}
+
+}
@@ -0,0 +1,263 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Longest STRING key kept in the index. Longer attribute values are cut to this many bytes.
+ */
+const int STRINGSIZE = 64;
+
+/*
+String keys vary in length, so STRING nodes are slotted pages. A fixed size header is followed by an
+array of slots growing up from the front of the page, while the key bytes they point to grow down from
+the end of the page. The bytes shared by every key of a node are stored once, at the very end of the
+page, and each slot only points to the rest of its key. Slots are kept in key order so a node can be
+binary searched without decoding it.
+*/
+
+/**
+ * @brief Slot of a STRING leaf: where the key suffix lies in the page and the record it belongs to.
+ */
+struct StringLeafSlot {
+  /**
+   * Offset of the key suffix from the start of the page.
+   */
+	std::uint16_t offset;
+
+  /**
+   * Length of the key suffix.
+   */
+	std::uint16_t length;
+
+  /**
+   * Record the key belongs to.
+   */
+	RecordId rid;
+};
+
+/**
+ * @brief Slot of a STRING non-leaf: where the key suffix lies in the page and the child to its right.
+ */
+struct StringNonLeafSlot {
+  /**
+   * Offset of the key suffix from the start of the page.
+   */
+	std::uint16_t offset;
+
+  /**
+   * Length of the key suffix.
+   */
+	std::uint16_t length;
+
+  /**
+   * Page number of the child holding keys greater than or equal to this one.
+   */
+	PageId pageNo;
+};
+
+/**
+ * @brief Structure for all leaf nodes when the key is of STRING type.
+*/
+struct StringLeafNode {
+  /**
+   * Page number of the leaf on the right side.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Number of keys in use.
+   */
+	std::uint16_t numKeys;
+
+  /**
+   * Number of leading bytes shared by all keys, stored once at the end of the page.
+   */
+	std::uint16_t prefixLength;
+
+  /**
+   * Offset of the lowest key byte in use. Free space lies between the slots and here.
+   */
+	std::uint16_t heapOffset;
+
+	std::uint16_t reserved;
+
+  /**
+   * Slots in key order. Only the first numKeys are in use; the key bytes share the rest of the page.
+   */
+	StringLeafSlot slotArray[ ( Page::SIZE - sizeof( PageId ) - 4 * sizeof( std::uint16_t ) ) / sizeof( StringLeafSlot ) ];
+};
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of STRING type.
+*/
+struct StringNonLeafNode {
+  /**
+   * Level of the node in the tree, 1 if its children are leaves.
+   */
+	std::uint16_t level;
+
+  /**
+   * Number of keys in use. The node has numKeys + 1 children.
+   */
+	std::uint16_t numKeys;
+
+  /**
+   * Number of leading bytes shared by all keys, stored once at the end of the page.
+   */
+	std::uint16_t prefixLength;
+
+  /**
+   * Offset of the lowest key byte in use. Free space lies between the slots and here.
+   */
+	std::uint16_t heapOffset;
+
+  /**
+   * Page number of the child holding keys less than the first key.
+   */
+	PageId firstPageNo;
+
+  /**
+   * Slots in key order. Only the first numKeys are in use; the key bytes share the rest of the page.
+   */
+	StringNonLeafSlot slotArray[ ( Page::SIZE - sizeof( PageId ) - 4 * sizeof( std::uint16_t ) ) / sizeof( StringNonLeafSlot ) ];
+};
+
+/**
+ * Returns key i of a leaf.
+ */
+std::string stringKey(const StringLeafNode *node, const int i);
+
+/**
+ * Returns key i of a non-leaf.
+ */
+std::string stringKey(const StringNonLeafNode *node, const int i);
+
+/**
+ * Compares key i of a leaf with key.
+ * @return  Less than, equal to or greater than zero as key i is less than, equal to or greater than key.
+ */
+int compareStringKey(const StringLeafNode *node, const int i, const std::string &key);
+
+/**
+ * Returns the index of the first key of a leaf that is not less than key.
+ */
+int lowerBound(const StringLeafNode *node, const std::string &key);
+
+/**
+ * Returns the index of the first key of a leaf that is greater than key.
+ */
+int upperBound(const StringLeafNode *node, const std::string &key);
+
+/**
+ * Returns the index of the first key of a non-leaf that is not less than key, which is also
+ * the index of the leftmost child that may hold key.
+ */
+int lowerBound(const StringNonLeafNode *node, const std::string &key);
+
+/**
+ * Returns the index of the first key of a non-leaf that is greater than key, which is also
+ * the index of the child to descend into for key.
+ */
+int upperBound(const StringNonLeafNode *node, const std::string &key);
+
+/**
+ * Returns page number of child i of a non-leaf.
+ */
+PageId childPageNo(const StringNonLeafNode *node, const int i);
+
+/**
+ * Bytes a leaf holding the given keys takes up once encoded.
+ */
+int stringLeafSize(const std::vector<std::string> &keys, const int begin, const int end);
+
+/**
+ * Bytes a non-leaf holding the given keys takes up once encoded.
+ */
+int stringNonLeafSize(const std::vector<std::string> &keys, const int begin, const int end);
+
+/**
+ * Bytes a leaf takes up now, and bytes it would take up if its keys shared no prefix.
+ * Adding a key can shorten the prefix, so only the second tells how much room is left for sure.
+ */
+int stringLeafSize(const StringLeafNode *node, const bool withoutPrefix);
+
+/**
+ * Bytes a non-leaf takes up now, and bytes it would take up if its keys shared no prefix.
+ */
+int stringNonLeafSize(const StringNonLeafNode *node, const bool withoutPrefix);
+
+/**
+ * Reads all entries of a leaf.
+ */
+void decodeStringLeaf(const StringLeafNode *node, std::vector<std::string> &keys, std::vector<RecordId> &rids);
+
+/**
+ * Reads all keys and children of a non-leaf.
+ */
+void decodeStringNonLeaf(const StringNonLeafNode *node, std::vector<std::string> &keys, std::vector<PageId> &pageNos);
+
+/**
+ * Rewrites a leaf to hold entries [begin, end) of keys and rids. The sibling pointer is kept.
+ * @return  False, leaving the node untouched, if the entries do not fit in a page.
+ */
+bool encodeStringLeaf(StringLeafNode *node, const std::vector<std::string> &keys,
+                      const std::vector<RecordId> &rids, const int begin, const int end);
+
+/**
+ * Rewrites a non-leaf to hold keys [begin, end) and the children around them, pageNos[begin, end].
+ * The level is kept.
+ * @return  False, leaving the node untouched, if the keys do not fit in a page.
+ */
+bool encodeStringNonLeaf(StringNonLeafNode *node, const std::vector<std::string> &keys,
+                         const std::vector<PageId> &pageNos, const int begin, const int end);
+
+/**
+ * Number of keys from keys[begin] on that fit in a leaf of budget bytes, but at least one if there is any.
+ */
+int stringLeafFill(const std::vector<std::string> &keys, const int begin, const int budget);
+
+/**
+ * Number of keys from keys[begin] on that fit in a non-leaf of budget bytes, but at least one if there is any.
+ */
+int stringNonLeafFill(const std::vector<std::string> &keys, const int begin, const int budget);
+
+/**
+ * Picks the point k to split the keys of an overfull node at, so that both halves fit in a page and
+ * take up about as many bytes. A leaf keeps keys [0, k) and moves [k, end) right. A non-leaf keeps
+ * keys [0, k), moves key k up and keys (k, end) right.
+ */
+int stringSplitPoint(const std::vector<std::string> &keys, const bool isLeaf);
+
+/**
+ * Inserts an entry as slot i of a leaf without rewriting it.
+ * @return  False, leaving the node untouched, if key does not start with the prefix of the leaf
+ *          or there is no room for it.
+ */
+bool insertStringLeafEntry(StringLeafNode *node, const int i, const std::string &key, const RecordId rid);
+
+/**
+ * Removes slot i of a leaf and the key bytes it points to without rewriting the leaf.
+ */
+void removeStringLeafEntry(StringLeafNode *node, const int i);
+
+/**
+ * Returns the shortest separator s with left < s <= right, which is a prefix of right.
+ * If left and right are equal, right itself is returned.
+ */
+std::string truncatedSeparator(const std::string &left, const std::string &right);
+
+}